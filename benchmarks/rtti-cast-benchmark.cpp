@@ -0,0 +1,229 @@
+//
+//		rtti_cast vs dynamic_cast
+//
+//	Runs the acyclic visitor's side-cast over a mixed ShapeList
+//	twice: once with dynamic_cast and once with the home-brewed
+//	rtti_cast. Also times the bare diamond downcast out of a
+//	virtual base, which is the worst case for both.
+//
+//	Build with Google Benchmark:
+//		g++ -std=c++17 -O2 rtti-cast-benchmark.cpp -lbenchmark -lpthread
+//
+
+#include <vector>
+#include <random>
+#include <benchmark/benchmark.h>
+
+#include "../rtti/rtti.h"
+
+using namespace std;
+
+// Same cast of characters as visitor/acyclic-visitor.cpp,
+// with an accept for each kind of cast.
+class AbstractVisitor {
+	RTTI_DECLARE();
+public:
+	virtual ~AbstractVisitor() {}
+};
+
+class Shape {
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+
+	virtual void acceptDynamic( AbstractVisitor* av ) = 0;
+	virtual void acceptRTTI( AbstractVisitor* av ) = 0;
+};
+
+class Rectangle;
+class Circle;
+class Triangle;
+
+class RectangleVisitor {
+	RTTI_DECLARE();
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+};
+
+class CircleVisitor {
+	RTTI_DECLARE();
+public:
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class TriangleVisitor {
+	RTTI_DECLARE();
+public:
+	virtual void visit( Triangle* triangle ) = 0;
+};
+
+// Stamps out both accepts for a shape and its specialized visitor.
+template<typename ShapeType, typename VisitorType>
+class Visitable : public Shape {
+public:
+	using Shape::Shape;
+
+	void acceptDynamic( AbstractVisitor* av ) {
+
+		VisitorType* v = dynamic_cast<VisitorType*>( av );
+		if ( v ) {
+			v->visit( static_cast<ShapeType*>( this ) );
+		}
+	}
+
+	void acceptRTTI( AbstractVisitor* av ) {
+
+		VisitorType* v = rtti_cast<VisitorType*>( av );
+		if ( v ) {
+			v->visit( static_cast<ShapeType*>( this ) );
+		}
+	}
+};
+
+class Rectangle : public Visitable<Rectangle, RectangleVisitor> {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Visitable(x,y), w(w), h(h) {}
+};
+
+class Circle : public Visitable<Circle, CircleVisitor> {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Visitable(x,y), r(r) {}
+};
+
+class Triangle : public Visitable<Triangle, TriangleVisitor> {
+public:
+	float b, h;
+	Triangle( float x, float y, float b, float h ) : Visitable(x,y), b(b), h(h) {}
+};
+
+// Visits rectangles and circles but not triangles,
+// so a third of the casts fail, like the real thing.
+class AreaCalculator :
+	public AbstractVisitor,
+	public RectangleVisitor,
+	public CircleVisitor {
+	RTTI_DECLARE();
+public:
+	float total;
+	AreaCalculator() : total(0) {}
+
+	void visit( Rectangle* rectangle ) { total += rectangle->w * rectangle->h; }
+	void visit( Circle* circle ) { total += 3.1415f * circle->r * circle->r; }
+};
+
+RTTI_DEFINE(AbstractVisitor);
+RTTI_DEFINE(RectangleVisitor);
+RTTI_DEFINE(CircleVisitor);
+RTTI_DEFINE(TriangleVisitor);
+RTTI_DEFINE(AreaCalculator, AbstractVisitor, RectangleVisitor, CircleVisitor);
+
+typedef vector<Shape*> ShapeList;
+
+// Shuffled so the branch predictor doesn't get any freebies.
+static ShapeList makeShapes( size_t count ) {
+
+	ShapeList list;
+	mt19937 rng( 1234 );
+	for ( size_t i = 0; i < count; ++i ) {
+		switch ( rng() % 3 ) {
+			case 0: list.push_back( new Rectangle( 0, 0, 2, 3 ) ); break;
+			case 1: list.push_back( new Circle( 0, 0, 1 ) ); break;
+			default: list.push_back( new Triangle( 0, 0, 4, 5 ) ); break;
+		}
+	}
+	return list;
+}
+
+static void freeShapes( ShapeList& list ) {
+
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+}
+
+static void BM_AcceptDynamicCast( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0) );
+	AreaCalculator ac;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			list[i]->acceptDynamic( &ac );
+		}
+		benchmark::DoNotOptimize( ac.total );
+	}
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+	freeShapes( list );
+}
+BENCHMARK(BM_AcceptDynamicCast)->Range( 1 << 8, 1 << 18 );
+
+static void BM_AcceptRTTICast( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0) );
+	AreaCalculator ac;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			list[i]->acceptRTTI( &ac );
+		}
+		benchmark::DoNotOptimize( ac.total );
+	}
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+	freeShapes( list );
+}
+BENCHMARK(BM_AcceptRTTICast)->Range( 1 << 8, 1 << 18 );
+
+// The diamond from rtti/variadic-definition.cpp,
+// for downcasts out of a virtual base.
+class StaffMember {
+	RTTI_DECLARE();
+public:
+	virtual ~StaffMember() {}
+};
+
+class Librarian : virtual public StaffMember {
+	RTTI_DECLARE();
+};
+
+class Teacher : virtual public StaffMember {
+	RTTI_DECLARE();
+};
+
+class TeachingLibrarian : public Teacher, public Librarian {
+	RTTI_DECLARE();
+};
+
+RTTI_DEFINE(StaffMember);
+RTTI_DEFINE(Librarian, StaffMember);
+RTTI_DEFINE(Teacher, StaffMember);
+RTTI_DEFINE(TeachingLibrarian, Teacher, Librarian);
+
+static void BM_VirtualBaseDynamicCast( benchmark::State& state ) {
+
+	TeachingLibrarian teachingLibrarian;
+	StaffMember* staff = &teachingLibrarian;
+
+	for ( auto _ : state ) {
+		benchmark::DoNotOptimize( staff );
+		benchmark::DoNotOptimize( dynamic_cast<Librarian*>( staff ) );
+	}
+}
+BENCHMARK(BM_VirtualBaseDynamicCast);
+
+static void BM_VirtualBaseRTTICast( benchmark::State& state ) {
+
+	TeachingLibrarian teachingLibrarian;
+	StaffMember* staff = &teachingLibrarian;
+
+	for ( auto _ : state ) {
+		benchmark::DoNotOptimize( staff );
+		benchmark::DoNotOptimize( rtti_cast<Librarian*>( staff ) );
+	}
+}
+BENCHMARK(BM_VirtualBaseRTTICast);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,149 @@
+//
+//		Variant visit vs pointer accept
+//
+//	Sums areas over a shuffled list of Rectangles and Circles three ways:
+//	the classic pointer-based accept, a VariantList visited with an
+//	inlined function object, and a VariantList visited through the
+//	adapter that wraps the classic Visitor.
+//
+//	Build with Google Benchmark:
+//		g++ -std=c++17 -O2 variant-visitor-benchmark.cpp -lbenchmark -lpthread
+//
+
+#include <vector>
+#include <random>
+#include <benchmark/benchmark.h>
+
+#include "../visitor/variant-list.h"
+
+using namespace std;
+
+class Visitor;
+
+class Shape {
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+	virtual void accept( Visitor* visitor ) = 0;
+};
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class AreaCalculator : public Visitor {
+public:
+	float total;
+	AreaCalculator() : total(0) {}
+
+	void visit( Rectangle* rectangle ) { total += rectangle->w * rectangle->h; }
+	void visit( Circle* circle ) { total += 3.1415f * circle->r * circle->r; }
+};
+
+class InlineAreaCalculator {
+public:
+	float total;
+	InlineAreaCalculator() : total(0) {}
+
+	void operator()( Rectangle& rectangle ) { total += rectangle.w * rectangle.h; }
+	void operator()( Circle& circle ) { total += 3.1415f * circle.r * circle.r; }
+};
+
+typedef vector<Shape*> ShapeList;
+typedef VariantList<Rectangle, Circle> ShapeValues;
+
+// The same shuffled sequence for every benchmark.
+static vector<bool> makeMix( size_t count ) {
+
+	vector<bool> isRectangle( count );
+	mt19937 rng( 1234 );
+	for ( size_t i = 0; i < count; ++i ) {
+		isRectangle[i] = rng() % 2;
+	}
+	return isRectangle;
+}
+
+static void BM_PointerAccept( benchmark::State& state ) {
+
+	vector<bool> mix = makeMix( state.range(0) );
+	ShapeList list;
+	for ( size_t i = 0; i < mix.size(); ++i ) {
+		if ( mix[i] ) list.push_back( new Rectangle( 0, 0, 2, 3 ) );
+		else list.push_back( new Circle( 0, 0, 1 ) );
+	}
+
+	AreaCalculator ac;
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			list[i]->accept( &ac );
+		}
+		benchmark::DoNotOptimize( ac.total );
+	}
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+}
+BENCHMARK(BM_PointerAccept)->Range( 1 << 8, 1 << 20 );
+
+static ShapeValues makeValues( const vector<bool>& mix ) {
+
+	ShapeValues list;
+	list.reserve( mix.size() );
+	for ( size_t i = 0; i < mix.size(); ++i ) {
+		if ( mix[i] ) list.emplace<Rectangle>( 0, 0, 2, 3 );
+		else list.emplace<Circle>( 0, 0, 1 );
+	}
+	return list;
+}
+
+static void BM_VariantVisit( benchmark::State& state ) {
+
+	ShapeValues list = makeValues( makeMix( state.range(0) ) );
+
+	InlineAreaCalculator ac;
+	for ( auto _ : state ) {
+		list.visit( ac );
+		benchmark::DoNotOptimize( ac.total );
+	}
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+}
+BENCHMARK(BM_VariantVisit)->Range( 1 << 8, 1 << 20 );
+
+static void BM_VariantAdapter( benchmark::State& state ) {
+
+	ShapeValues list = makeValues( makeMix( state.range(0) ) );
+
+	AreaCalculator ac;
+	Visitor* visitor = &ac;
+	for ( auto _ : state ) {
+		list.visit( adapt( visitor ) );
+		benchmark::DoNotOptimize( ac.total );
+	}
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+}
+BENCHMARK(BM_VariantAdapter)->Range( 1 << 8, 1 << 20 );
+
+BENCHMARK_MAIN();
@@ -0,0 +1,372 @@
+//
+//		Visitor dispatch shoot-out
+//
+//	Sums a value over a ShapeList four ways:
+//
+//		naive		NaiveVisitor::doVisit, a dynamic_cast per shape type
+//		classic		the Visitor from visitor/visitor.cpp, one virtual accept
+//		acyclic		the acyclic visitor, a dynamic_cast side-cast in accept
+//		rtti		doVisit again, but with RTTI::derivesFrom instead of dynamic_cast
+//
+//	The hierarchy is made up on the spot: HIERARCHY_WIDTH leaf shape types,
+//	each sitting HIERARCHY_DEPTH classes below Shape. Change them on the
+//	command line to see how each approach copes with a deep or wide tree.
+//
+//	Every benchmark takes two arguments:
+//		shapes		list size, 1e2 to BENCH_MAX_SHAPES (1e7 unless you say otherwise)
+//		mix			0 = shuffled evenly, 1 = sorted by type, 2 = mostly one type
+//
+//	"per_elem" is the time per shape. For branch misses, run with
+//		--benchmark_perf_counters=BRANCH-MISSES,INSTRUCTIONS
+//	(Google Benchmark needs to be built with libpfm for that; otherwise
+//	perf stat on a --benchmark_filter'd run does the job.)
+//
+//	Build with Google Benchmark:
+//		g++ -std=c++17 -O2 -DHIERARCHY_WIDTH=8 -DHIERARCHY_DEPTH=3 visitor-dispatch-benchmark.cpp -lbenchmark -lpthread
+//
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <benchmark/benchmark.h>
+
+#include "../rtti/rtti.h"
+
+#ifndef HIERARCHY_WIDTH
+#define HIERARCHY_WIDTH 4
+#endif
+
+#ifndef HIERARCHY_DEPTH
+#define HIERARCHY_DEPTH 1
+#endif
+
+#ifndef BENCH_MAX_SHAPES
+#define BENCH_MAX_SHAPES 10000000
+#endif
+
+static_assert( HIERARCHY_WIDTH >= 1 && HIERARCHY_DEPTH >= 1, "need at least one shape type, one level down" );
+
+using namespace std;
+
+class Visitor;
+class AbstractVisitor;
+
+class Shape {
+	RTTI_DECLARE();
+public:
+	virtual ~Shape() {}
+	float value;
+	explicit Shape( float value ) : value(value) {}
+
+	virtual void accept( Visitor* visitor ) = 0;
+	virtual void acceptAcyclic( AbstractVisitor* av ) = 0;
+};
+
+RTTI_DEFINE(Shape);
+
+// Node<I, D> is the D'th class down the I'th branch.
+// The one at the bottom of each branch is the shape that actually gets made.
+template<int I, int D>
+class Node;
+
+template<int I>
+using Leaf = Node<I, HIERARCHY_DEPTH>;
+
+template<int I, int D>
+struct NodeParent {
+	typedef Node<I, D - 1> type;
+};
+
+template<int I>
+struct NodeParent<I, 1> {
+	typedef Shape type;
+};
+
+// the classic Visitor, one visit per leaf
+template<int I>
+class VisitorPart : public VisitorPart<I - 1> {
+public:
+	using VisitorPart<I - 1>::visit;
+	virtual void visit( Leaf<I>* leaf ) = 0;
+};
+
+template<>
+class VisitorPart<0> {
+public:
+	virtual ~VisitorPart() {}
+	virtual void visit( Leaf<0>* leaf ) = 0;
+};
+
+class Visitor : public VisitorPart<HIERARCHY_WIDTH - 1> {};
+
+// the acyclic visitor, one interface per leaf
+class AbstractVisitor {
+public:
+	virtual ~AbstractVisitor() {}
+};
+
+template<int I>
+class LeafVisitor {
+public:
+	virtual void visit( Leaf<I>* leaf ) = 0;
+};
+
+template<int I, int D>
+class Node : public NodeParent<I, D>::type {
+	RTTI_DECLARE();
+public:
+	typedef typename NodeParent<I, D>::type Parent;
+	using Parent::Parent;
+
+	// only the bottom of the branch is visitable
+	void accept( Visitor* visitor ) {
+
+		if constexpr ( D == HIERARCHY_DEPTH ) {
+			visitor->visit( this );
+		}
+	}
+
+	void acceptAcyclic( AbstractVisitor* av ) {
+
+		if constexpr ( D == HIERARCHY_DEPTH ) {
+
+			LeafVisitor<I>* v = dynamic_cast<LeafVisitor<I>*>( av );
+			if ( v ) {
+				v->visit( this );
+			}
+		}
+	}
+};
+
+// RTTI_DEFINE is for plain classes, so the templates spell it out
+template<int I, int D>
+struct RTTIInfoOf<Node<I, D>> : RTTIInfo<Node<I, D>, typename NodeParent<I, D>::type> {};
+
+// "Node" + I + "_" + D, spelled out by the compiler so the typeInfo
+// below is a constant like any RTTI_DEFINE one
+constexpr int digitCount( int n ) {
+
+	return n < 10 ? 1 : 1 + digitCount( n / 10 );
+}
+
+template<int I, int D>
+struct NodeName {
+	char value[4 + digitCount( I ) + 1 + digitCount( D ) + 1];
+};
+
+constexpr int writeNumber( char* out, int n ) {
+
+	const int length = digitCount( n );
+	for ( int i = length - 1; i >= 0; --i, n /= 10 ) {
+		out[i] = char( '0' + n % 10 );
+	}
+	return length;
+}
+
+template<int I, int D>
+constexpr NodeName<I, D> makeNodeName() {
+
+	NodeName<I, D> name = {};
+	int at = 0;
+	for ( const char* prefix = "Node"; *prefix; ++prefix ) {
+		name.value[at++] = *prefix;
+	}
+	at += writeNumber( name.value + at, I );
+	name.value[at++] = '_';
+	writeNumber( name.value + at, D );
+	return name;
+}
+
+template<int I, int D>
+constexpr NodeName<I, D> nodeName = makeNodeName<I, D>();
+
+template<int I, int D>
+RTTI_CONSTINIT const RTTI Node<I, D>::typeInfo( nodeName<I, D>.value, rtti_name_hash( nodeName<I, D>.value ),
+	RTTIInfoOf<Node<I, D>>::parents, RTTIInfoOf<Node<I, D>>::parentCount, &RTTIInfoOf<Node<I, D>>::recordCompleteOffsets,
+	&RTTIInfoOf<Node<I, D>>::runtimeState );
+
+// Every approach adds up the same thing.
+template<int I>
+class SummerPart : public SummerPart<I - 1> {
+public:
+	using SummerPart<I - 1>::visit;
+	void visit( Leaf<I>* leaf ) { this->total += leaf->value * ( I + 1 ); }
+};
+
+template<>
+class SummerPart<-1> : public Visitor {
+public:
+	float total;
+	SummerPart() : total(0) {}
+};
+
+typedef SummerPart<HIERARCHY_WIDTH - 1> Summer;
+
+template<int I, typename Derived>
+class LeafSummer : public LeafVisitor<I> {
+public:
+	void visit( Leaf<I>* leaf ) { static_cast<Derived*>( this )->total += leaf->value * ( I + 1 ); }
+};
+
+template<typename Indices>
+class AcyclicSummerOf;
+
+template<int... Is>
+class AcyclicSummerOf<integer_sequence<int, Is...>>
+	: public AbstractVisitor, public LeafSummer<Is, AcyclicSummerOf<integer_sequence<int, Is...>>>... {
+public:
+	float total;
+	AcyclicSummerOf() : total(0) {}
+};
+
+typedef AcyclicSummerOf<make_integer_sequence<int, HIERARCHY_WIDTH>> AcyclicSummer;
+
+// NaiveVisitor::doVisit, stretched out over every leaf.
+// Like the original, it keeps trying casts after one works.
+template<int... Is>
+static void doVisitDynamic( Visitor& visitor, Shape* shape, integer_sequence<int, Is...> ) {
+
+	( [&] {
+		Leaf<Is>* leaf = dynamic_cast<Leaf<Is>*>( shape );
+		if ( leaf )
+			visitor.visit( leaf );
+	}(), ... );
+}
+
+template<int... Is>
+static void doVisitRTTI( Visitor& visitor, Shape* shape, integer_sequence<int, Is...> ) {
+
+	const RTTI& type = shape->getTypeInfo();
+	( [&] {
+		if ( type.derivesFrom( Leaf<Is>::typeInfo ) )
+			visitor.visit( static_cast<Leaf<Is>*>( shape ) );
+	}(), ... );
+}
+
+typedef vector<Shape*> ShapeList;
+typedef Shape* (*LeafMaker)();
+
+template<int... Is>
+static vector<LeafMaker> leafMakers( integer_sequence<int, Is...> ) {
+
+	return { []() -> Shape* { return new Leaf<Is>( 1.0f ); }... };
+}
+
+enum Mix { SHUFFLED, SORTED, SKEWED };
+
+static ShapeList makeShapes( size_t count, Mix mix ) {
+
+	const vector<LeafMaker> makers = leafMakers( make_integer_sequence<int, HIERARCHY_WIDTH>() );
+
+	vector<int> kinds( count );
+	mt19937 rng( 1234 );
+	for ( size_t i = 0; i < count; ++i ) {
+		kinds[i] = ( mix == SKEWED && rng() % 8 != 0 ) ? 0 : rng() % HIERARCHY_WIDTH;
+	}
+
+	if ( mix == SORTED ) {
+		sort( kinds.begin(), kinds.end() );
+	}
+
+	ShapeList list;
+	list.reserve( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		list.push_back( makers[kinds[i]]() );
+	}
+	return list;
+}
+
+static void freeShapes( ShapeList& list ) {
+
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+}
+
+static void report( benchmark::State& state, const ShapeList& list ) {
+
+	state.SetItemsProcessed( state.iterations() * list.size() );
+	state.counters["per_elem"] = benchmark::Counter( list.size(),
+		benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert );
+}
+
+static void BM_Naive( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0), Mix( state.range(1) ) );
+	Summer summer;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			doVisitDynamic( summer, list[i], make_integer_sequence<int, HIERARCHY_WIDTH>() );
+		}
+		benchmark::DoNotOptimize( summer.total );
+	}
+
+	report( state, list );
+	freeShapes( list );
+}
+
+static void BM_Classic( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0), Mix( state.range(1) ) );
+	Summer summer;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			list[i]->accept( &summer );
+		}
+		benchmark::DoNotOptimize( summer.total );
+	}
+
+	report( state, list );
+	freeShapes( list );
+}
+
+static void BM_Acyclic( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0), Mix( state.range(1) ) );
+	AcyclicSummer summer;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			list[i]->acceptAcyclic( &summer );
+		}
+		benchmark::DoNotOptimize( summer.total );
+	}
+
+	report( state, list );
+	freeShapes( list );
+}
+
+static void BM_RTTI( benchmark::State& state ) {
+
+	ShapeList list = makeShapes( state.range(0), Mix( state.range(1) ) );
+	Summer summer;
+
+	for ( auto _ : state ) {
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			doVisitRTTI( summer, list[i], make_integer_sequence<int, HIERARCHY_WIDTH>() );
+		}
+		benchmark::DoNotOptimize( summer.total );
+	}
+
+	report( state, list );
+	freeShapes( list );
+}
+
+static void shapeArgs( benchmark::internal::Benchmark* b ) {
+
+	b->ArgNames( { "shapes", "mix" } );
+	for ( long count = 100; count <= BENCH_MAX_SHAPES; count *= 10 ) {
+		for ( int mix = SHUFFLED; mix <= SKEWED; ++mix ) {
+			b->Args( { count, mix } );
+		}
+	}
+}
+
+BENCHMARK(BM_Naive)->Apply( shapeArgs );
+BENCHMARK(BM_Classic)->Apply( shapeArgs );
+BENCHMARK(BM_Acyclic)->Apply( shapeArgs );
+BENCHMARK(BM_RTTI)->Apply( shapeArgs );
+
+BENCHMARK_MAIN();
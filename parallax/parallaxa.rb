@@ -51,6 +51,7 @@ end
 # that is to say, fills a view with a sprite,
 # tiling (repeating) it horizontally/vertically to completely fill the space
 # it's actually a little more general than we need here, but whatevs
+# (tiler.h has a native version that culls to the view and batches each layer into one draw)
 class Tiler
 	def initialize(view, imageName, h_start, v_start, is_tiling_h, is_tiling_v)
 		@view = view
@@ -0,0 +1,123 @@
+// the native tiler, taken for a spin
+// same layers as ParallaxGame in parallaxa.rb, same ship flying right,
+// but instead of drawing we count what would've been drawn
+//
+// run it from this directory, same as parallaxa.rb, so it can find resources/
+// the tiler itself lives in tiler.h
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cassert>
+
+#include "tiler.h"
+
+using namespace std;
+
+const float APP_WIDTH = 640;
+const float APP_HEIGHT = 480;
+
+// a png's width and height live in its first chunk, big-endian, so we don't need a png library
+bool imageSize( const string& path, float& width, float& height ) {
+
+	ifstream file( path.c_str(), ios::binary );
+	unsigned char header[24];
+	if ( !file.read( reinterpret_cast<char*>( header ), sizeof( header ) ) ) {
+		return false;
+	}
+
+	width = float( ( header[16] << 24 ) | ( header[17] << 16 ) | ( header[18] << 8 ) | header[19] );
+	height = float( ( header[20] << 24 ) | ( header[21] << 16 ) | ( header[22] << 8 ) | header[23] );
+	return true;
+}
+
+// one background layer: a tiler and how fast its view moves
+struct Layer {
+	string image;
+	float speed;
+	Tiler tiler;
+	float tileWidth;
+};
+
+// how many draw_image calls the Ruby Tiler makes for a horizontally tiled layer
+// (min_x..max_x).step(tile_width), so one per tile from min_x up to and including max_x
+int rubyDrawCalls( const View& view, float tileWidth ) {
+
+	const float minX = floor( view.left / tileWidth ) * tileWidth;
+	const float maxX = view.left + view.width;
+	return int( floor( ( maxX - minX ) / tileWidth ) ) + 1;
+}
+
+int main() {
+
+	struct { const char* image; float y; float speed; } setup[] = {
+		{ "resources/Background.png", 0, 0.01f },
+		{ "resources/Mountains.png", 262, 0.1f },
+		{ "resources/Sand.png", 408, 1 },		// the sand just uses the main view
+		{ "resources/Trees2.png", 356, 0.8f },
+		{ "resources/Trees.png", 351, 0.9f },
+		{ "resources/Rocks2.png", 425, 1.1f },
+		{ "resources/Rocks1.png", 425, 1.2f },
+	};
+
+	vector<Layer> layers;
+	for ( size_t i = 0; i < sizeof( setup ) / sizeof( setup[0] ); ++i ) {
+
+		float width, height;
+		if ( !imageSize( setup[i].image, width, height ) ) {
+			cout << "couldn't read " << setup[i].image << " (run this from the parallax directory)" << endl;
+			return 1;
+		}
+
+		Layer layer = { setup[i].image, setup[i].speed, Tiler( width, height, 0, setup[i].y, true, false ), width };
+		layers.push_back( layer );
+	}
+
+	// the ship flies right for a while, and the HorizontalEntityView follows it
+	const int FRAMES = 600;
+	int rubyCalls = 0, batchedCalls = 0, rebuilds = 0, quads = 0;
+	float shipX = APP_WIDTH / 2;
+
+	for ( int frame = 0; frame < FRAMES; ++frame ) {
+
+		shipX += 5;
+		const View mainView( shipX - APP_WIDTH / 2, 0, APP_WIDTH, APP_HEIGHT );
+
+		for ( size_t i = 0; i < layers.size(); ++i ) {
+
+			const View view = mainView.parallax( layers[i].speed, true );
+			const Tiler::Batch& batch = layers[i].tiler.render( view );
+
+			rubyCalls += rubyDrawCalls( view, layers[i].tileWidth );
+			batchedCalls += batch.quads.empty() ? 0 : 1;
+			rebuilds += batch.rebuilt ? 1 : 0;
+			quads += int( batch.quads.size() );
+
+			// whatever's in the batch has to cover the view
+			assert( !batch.quads.empty() );
+			assert( batch.quads.front().x <= view.left );
+			assert( batch.quads.back().x + batch.quads.back().w >= view.left + view.width );
+
+			// and the wrapped version is the view, exactly
+			Quad wrapped;
+			assert( layers[i].tiler.renderWrapped( view, wrapped ) );
+			assert( wrapped.x == 0 && wrapped.w == view.width );
+		}
+	}
+
+	cout << "frames: " << FRAMES << ", layers: " << layers.size() << endl;
+	cout << "draw calls, one per tile: " << rubyCalls << endl;
+	cout << "draw calls, one per layer: " << batchedCalls << endl;
+	cout << "quads drawn: " << quads << endl;
+	cout << "batches rebuilt: " << rebuilds << " of " << FRAMES * layers.size() << endl;
+
+	// a layer that's scrolled out of view draws nothing at all
+	Tiler offscreen( 100, 50, 0, 1000, true, false );
+	assert( offscreen.render( View( 0, 0, APP_WIDTH, APP_HEIGHT ) ).quads.empty() );
+	Quad nothing;
+	assert( !offscreen.renderWrapped( View( 0, 0, APP_WIDTH, APP_HEIGHT ), nothing ) );
+
+	return 0;
+}
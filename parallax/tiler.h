@@ -0,0 +1,178 @@
+#ifndef TILER_H
+#define TILER_H
+
+#include <vector>
+#include <cmath>
+
+// The native version of the Tiler from parallaxa.rb, minus the drawing.
+//
+// Instead of a draw_image per tile, a layer comes out as one list of
+// quads to hand to the renderer in a single draw, or as one quad with
+// texture coordinates running past the edge of the texture for a
+// renderer with wrap (repeat) mode turned on.
+//
+// Only tiles that overlap the view make the list. The quads are in
+// world space; the renderer translates the whole batch by offsetX and
+// offsetY, so as long as the view stays inside the same tiles the
+// list doesn't change and needn't be uploaded again. rebuilt says
+// when it did change.
+
+// Same as the View in parallaxa.rb: a window onto the world.
+struct View {
+	float left, top, width, height;
+
+	View() : left(0), top(0), width(0), height(0) {}
+	View( float left, float top, float width, float height ) : left(left), top(top), width(width), height(height) {}
+
+	// what a ParallaxView tracking this one would see
+	View parallax( float relativeSpeed, bool horizontal, bool vertical = false ) const {
+
+		return View( left * ( horizontal ? relativeSpeed : 1 ), top * ( vertical ? relativeSpeed : 1 ), width, height );
+	}
+};
+
+// A textured rectangle. u and v are in tiles, so 0 to 1 is one copy of the image.
+struct Quad {
+	float x, y, w, h;
+	float u0, v0, u1, v1;
+};
+
+class Tiler {
+public:
+	struct Batch {
+		std::vector<Quad> quads;
+		float offsetX, offsetY;		// world to screen, for the whole batch
+		bool rebuilt;				// the quads changed since the last render
+	};
+
+	Tiler( float tileWidth, float tileHeight, float xOffset, float yOffset, bool tilingH, bool tilingV )
+		: m_tileWidth( tileWidth ), m_tileHeight( tileHeight )
+		  , m_xOffset( xOffset ), m_yOffset( yOffset )
+		  , m_tilingH( tilingH ), m_tilingV( tilingV )
+		  , m_valid( false )
+	{
+		m_batch.offsetX = m_batch.offsetY = 0;
+		m_batch.rebuilt = false;
+	}
+
+	// every visible tile, as one batch
+	const Batch& render( const View& view ) {
+
+		Range range;
+		range.visible = columns( view, range.firstX, range.lastX ) && rows( view, range.firstY, range.lastY );
+
+		m_batch.offsetX = -view.left;
+		m_batch.offsetY = -view.top;
+		m_batch.rebuilt = !m_valid || !( range == m_range );
+
+		if ( m_batch.rebuilt ) {
+
+			m_range = range;
+			m_valid = true;
+			m_batch.quads.clear();
+
+			if ( range.visible ) {
+				for ( int ty = range.firstY; ty <= range.lastY; ++ty ) {
+					for ( int tx = range.firstX; tx <= range.lastX; ++tx ) {
+
+						const Quad quad = { m_xOffset + tx * m_tileWidth, m_yOffset + ty * m_tileHeight, m_tileWidth, m_tileHeight, 0, 0, 1, 1 };
+						m_batch.quads.push_back( quad );
+					}
+				}
+			}
+		}
+
+		return m_batch;
+	}
+
+	// The whole layer as one quad, in screen space, for a texture in wrap mode.
+	// False if none of it's in view.
+	bool renderWrapped( const View& view, Quad& quad ) const {
+
+		int first, last;
+		if ( !columns( view, first, last ) || !rows( view, first, last ) ) {
+			return false;
+		}
+
+		if ( m_tilingH ) {
+			quad.x = 0;
+			quad.w = view.width;
+			quad.u0 = ( view.left - m_xOffset ) / m_tileWidth;
+			quad.u1 = quad.u0 + view.width / m_tileWidth;
+		}
+		else {
+			quad.x = m_xOffset - view.left;
+			quad.w = m_tileWidth;
+			quad.u0 = 0;
+			quad.u1 = 1;
+		}
+
+		if ( m_tilingV ) {
+			quad.y = 0;
+			quad.h = view.height;
+			quad.v0 = ( view.top - m_yOffset ) / m_tileHeight;
+			quad.v1 = quad.v0 + view.height / m_tileHeight;
+		}
+		else {
+			quad.y = m_yOffset - view.top;
+			quad.h = m_tileHeight;
+			quad.v0 = 0;
+			quad.v1 = 1;
+		}
+
+		return true;
+	}
+
+private:
+	// which tiles, inclusive, and whether there are any
+	struct Range {
+		int firstX, lastX, firstY, lastY;
+		bool visible;
+
+		Range() : firstX(0), lastX(0), firstY(0), lastY(0), visible(false) {}
+
+		bool operator==( const Range& other ) const {
+
+			if ( visible != other.visible ) {
+				return false;
+			}
+			return !visible || ( firstX == other.firstX && lastX == other.lastX && firstY == other.firstY && lastY == other.lastY );
+		}
+	};
+
+	// The tiles covering [start, start + length) along one axis.
+	// Going from world space to tile space, same as min_tile_x in the Ruby.
+	static bool span( float start, float length, float offset, float tileSize, bool tiling, int& first, int& last ) {
+
+		if ( !tiling ) {
+
+			// just the one tile at the offset, if it's in view at all
+			first = last = 0;
+			return offset < start + length && offset + tileSize > start;
+		}
+
+		first = int( std::floor( ( start - offset ) / tileSize ) );
+		last = int( std::ceil( ( start + length - offset ) / tileSize ) ) - 1;
+		return last >= first;
+	}
+
+	bool columns( const View& view, int& first, int& last ) const {
+
+		return span( view.left, view.width, m_xOffset, m_tileWidth, m_tilingH, first, last );
+	}
+
+	bool rows( const View& view, int& first, int& last ) const {
+
+		return span( view.top, view.height, m_yOffset, m_tileHeight, m_tilingV, first, last );
+	}
+
+	const float m_tileWidth, m_tileHeight;
+	const float m_xOffset, m_yOffset;
+	const bool m_tilingH, m_tilingV;
+
+	Range m_range;
+	bool m_valid;
+	Batch m_batch;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef RTTI_INSTRUMENTATION_H
+#define RTTI_INSTRUMENTATION_H
+
+#include <cstdint>
+#include <cstddef>
+
+#ifdef ENABLE_INSTRUMENTATION
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+/**
+ * 	HOW MANY TIMES DID WE DO THAT AGAIN
+ *
+ * 	Counts calls to the hot bits: Shape::accept, the acyclic visitor's
+ * 	side-cast (rtti_cast) and RTTI::derivesFrom. With timers on, it adds
+ * 	up the cycles spent in each one too.
+ *
+ * 	It's all off unless you build with -DENABLE_INSTRUMENTATION.
+ * 	Add -DENABLE_INSTRUMENTATION_TIMERS for the timers.
+ * 	Off means the probe macros expand to nothing, so it costs nothing.
+ *
+ * 	Every thread bumps its own counters, with plain loads and stores,
+ * 	so there's no locked instruction or shared cache line on the hot path.
+ * 	snapshot() adds up every thread's counters, including threads that
+ * 	have already finished. The numbers from threads still running can be
+ * 	a little behind, which is fine for profiling.
+ *
+ * 	Cycles are TSC ticks on x86 and nanoseconds everywhere else, and
+ * 	they include the timer's own overhead, so treat them as relative.
+ */
+class Instrumentation {
+public:
+	enum Probe {
+		ACCEPT,
+		SIDE_CAST,
+		DERIVES_FROM,
+		PROBE_COUNT
+	};
+
+	struct Snapshot {
+		std::uint64_t calls[PROBE_COUNT];
+		std::uint64_t cycles[PROBE_COUNT];
+	};
+
+#ifdef ENABLE_INSTRUMENTATION
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+#ifdef ENABLE_INSTRUMENTATION_TIMERS
+	static constexpr bool timed = enabled;
+#else
+	static constexpr bool timed = false;
+#endif
+
+	static const char* probeName( Probe probe ) {
+
+		static const char* const s_names[PROBE_COUNT] = { "accept", "side-cast", "derivesFrom" };
+		return s_names[probe];
+	}
+
+	// all zeros when it's compiled out
+	static Snapshot snapshot();
+
+	// zeros every counter, for measuring one stretch of a run
+	static void reset();
+
+#ifdef ENABLE_INSTRUMENTATION
+	static void count( Probe probe ) {
+
+		bump( local().calls[probe], 1 );
+	}
+
+	static void addCycles( Probe probe, std::uint64_t cycles ) {
+
+		bump( local().cycles[probe], cycles );
+	}
+
+	static std::uint64_t now() {
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+	}
+
+	// counts on the way in, times until it goes out of scope
+	class Scope {
+	public:
+		explicit Scope( Probe probe ) : m_probe( probe ), m_start( timed ? now() : 0 ) {
+
+			count( probe );
+		}
+
+		~Scope() {
+
+			if ( timed ) {
+				addCycles( m_probe, now() - m_start );
+			}
+		}
+
+		Scope( const Scope& ) = delete;
+		Scope& operator=( const Scope& ) = delete;
+
+	private:
+		const Probe m_probe;
+		const std::uint64_t m_start;
+	};
+
+private:
+	typedef std::atomic<std::uint64_t> Counter;
+
+	// only the owning thread writes, so no read-modify-write needed
+	static void bump( Counter& counter, std::uint64_t by ) {
+
+		counter.store( counter.load( std::memory_order_relaxed ) + by, std::memory_order_relaxed );
+	}
+
+	struct ThreadCounters {
+		ThreadCounters();
+		~ThreadCounters();
+
+		Counter calls[PROBE_COUNT];
+		Counter cycles[PROBE_COUNT];
+	};
+
+	struct State {
+		State() : retired() {}
+
+		std::mutex mutex;
+		std::vector<ThreadCounters*> live;
+		Snapshot retired; // from threads that are gone
+	};
+
+	// never destroyed, so threads exiting late can still check out
+	static State& state() {
+
+		static State* s_state = new State();
+		return *s_state;
+	}
+
+	static ThreadCounters& local() {
+
+		static thread_local ThreadCounters s_counters;
+		return s_counters;
+	}
+#endif
+};
+
+#ifdef ENABLE_INSTRUMENTATION
+
+inline Instrumentation::ThreadCounters::ThreadCounters() {
+
+	for ( unsigned p = 0; p < PROBE_COUNT; ++p ) {
+		calls[p].store( 0, std::memory_order_relaxed );
+		cycles[p].store( 0, std::memory_order_relaxed );
+	}
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.mutex );
+	s.live.push_back( this );
+}
+
+inline Instrumentation::ThreadCounters::~ThreadCounters() {
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.mutex );
+
+	for ( unsigned p = 0; p < PROBE_COUNT; ++p ) {
+		s.retired.calls[p] += calls[p].load( std::memory_order_relaxed );
+		s.retired.cycles[p] += cycles[p].load( std::memory_order_relaxed );
+	}
+
+	s.live.erase( std::find( s.live.begin(), s.live.end(), this ) );
+}
+
+inline Instrumentation::Snapshot Instrumentation::snapshot() {
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.mutex );
+
+	Snapshot total = s.retired;
+	for ( ThreadCounters* counters : s.live ) {
+		for ( unsigned p = 0; p < PROBE_COUNT; ++p ) {
+			total.calls[p] += counters->calls[p].load( std::memory_order_relaxed );
+			total.cycles[p] += counters->cycles[p].load( std::memory_order_relaxed );
+		}
+	}
+	return total;
+}
+
+// other threads' counters are theirs to write, so a reset while they're
+// busy can lose a few of their updates; do it between frames
+inline void Instrumentation::reset() {
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.mutex );
+
+	s.retired = Snapshot();
+	for ( ThreadCounters* counters : s.live ) {
+		for ( unsigned p = 0; p < PROBE_COUNT; ++p ) {
+			counters->calls[p].store( 0, std::memory_order_relaxed );
+			counters->cycles[p].store( 0, std::memory_order_relaxed );
+		}
+	}
+}
+
+#define INSTRUMENTATION_CONCAT2( a, b ) a##b
+#define INSTRUMENTATION_CONCAT( a, b ) INSTRUMENTATION_CONCAT2( a, b )
+
+// counts (and maybe times) the rest of the enclosing block
+#define INSTRUMENT_SCOPE( probe ) \
+	Instrumentation::Scope INSTRUMENTATION_CONCAT( instrumentationScope, __LINE__ )( Instrumentation::probe )
+
+#else
+
+inline Instrumentation::Snapshot Instrumentation::snapshot() {
+
+	return Snapshot();
+}
+
+inline void Instrumentation::reset() {}
+
+#define INSTRUMENT_SCOPE( probe ) ( ( void ) 0 )
+
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef RTTI_QUERY_CACHE_H
+#define RTTI_QUERY_CACHE_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "rtti.h"
+
+/**
+ * 	MEMO TO SELF: WE ALREADY ASKED
+ *
+ * 	An optional cache of derivesFrom answers keyed on the pair of type
+ * 	indices, for data-driven types built at runtime that get asked
+ * 	about the same few (type, base) pairs over and over.
+ *
+ * 	It's a small open-addressing table of 64-bit slots. Each slot packs
+ * 	both indices, the answer and a generation tag, so a slot is always
+ * 	read and written whole and readers on any thread never need a lock.
+ * 	When the table is crowded a new answer just replaces an old one.
+ *
+ * 	invalidate() bumps the generation, which makes every slot stale at
+ * 	once. A cache that follows the registry does that by itself
+ * 	whenever a new type gets registered (one extra load per query).
+ *
+ * 	Word of warning: ever since the ancestor bitsets went in, a plain
+ * 	RTTI::derivesFrom is one bit test, and on a warm cache it beats this
+ * 	(about 2ns vs 8ns on my machine). Measure before you reach for it.
+ *
+ * 	Indices have to fit in 28 bits.
+ */
+class RTTIQueryCache {
+public:
+	explicit RTTIQueryCache( unsigned capacityLog2 = 12, bool followRegistry = true )
+		: m_mask( ( std::size_t( 1 ) << capacityLog2 ) - 1 )
+		  , m_slots( new std::atomic<std::uint64_t>[m_mask + 1] )
+		  , m_followRegistry( followRegistry )
+		  , m_generation( 1 )
+		  , m_registeredTypes( RTTIRegistry::typeCount() )
+	{
+		for ( std::size_t i = 0; i <= m_mask; ++i ) {
+			m_slots[i].store( 0, std::memory_order_relaxed );
+		}
+	}
+
+	bool derivesFrom( const RTTI& derived, const RTTI& base ) {
+
+		if ( m_followRegistry ) {
+
+			const unsigned registered = RTTIRegistry::typeCount();
+			if ( registered != m_registeredTypes.load( std::memory_order_relaxed ) ) {
+
+				m_registeredTypes.store( registered, std::memory_order_relaxed );
+				invalidate();
+			}
+		}
+
+		const std::uint64_t generation = m_generation.load( std::memory_order_acquire );
+		const std::uint64_t key = keyOf( derived.getIndex(), base.getIndex() );
+		const std::size_t home = hash( key ) & m_mask;
+
+		for ( std::size_t probe = 0; probe < MAX_PROBES; ++probe ) {
+
+			const std::uint64_t slot = m_slots[( home + probe ) & m_mask].load( std::memory_order_acquire );
+			if ( slot == 0 ) {
+				break;
+			}
+
+			if ( ( slot & KEY_MASK ) == key && ( slot >> GENERATION_SHIFT ) == generation ) {
+				return ( slot >> RESULT_SHIFT ) & 1;
+			}
+		}
+
+		const bool result = derived.derivesFrom( base );
+		insert( key, generation, result, home );
+		return result;
+	}
+
+	void invalidate() {
+
+		std::uint64_t next = ( m_generation.load( std::memory_order_relaxed ) + 1 ) & GENERATION_MASK;
+
+		// the tag ran out of bits and wrapped, so old slots could look current again
+		if ( next == 0 ) {
+
+			for ( std::size_t i = 0; i <= m_mask; ++i ) {
+				m_slots[i].store( 0, std::memory_order_relaxed );
+			}
+			next = 1;
+		}
+
+		m_generation.store( next, std::memory_order_release );
+	}
+
+private:
+	static constexpr std::size_t MAX_PROBES = 8;
+	static constexpr unsigned INDEX_BITS = 28;
+	static constexpr std::uint64_t KEY_MASK = ( std::uint64_t( 1 ) << ( 2 * INDEX_BITS ) ) - 1;
+	static constexpr unsigned RESULT_SHIFT = 2 * INDEX_BITS;
+	static constexpr unsigned GENERATION_SHIFT = RESULT_SHIFT + 1;
+	static constexpr std::uint64_t GENERATION_MASK = ( std::uint64_t( 1 ) << ( 64 - GENERATION_SHIFT ) ) - 1;
+
+	// +1 so no key is ever all zeros, which is what an empty slot looks like
+	static std::uint64_t keyOf( unsigned derived, unsigned base ) {
+
+		return ( std::uint64_t( derived + 1 ) << INDEX_BITS ) | ( base + 1 );
+	}
+
+	static std::size_t hash( std::uint64_t key ) {
+
+		key *= 0x9E3779B97F4A7C15ull;
+		return static_cast<std::size_t>( key >> 32 );
+	}
+
+	void insert( std::uint64_t key, std::uint64_t generation, bool result, std::size_t home ) {
+
+		const std::uint64_t entry = key | ( std::uint64_t( result ) << RESULT_SHIFT ) | ( generation << GENERATION_SHIFT );
+
+		for ( std::size_t probe = 0; probe < MAX_PROBES; ++probe ) {
+
+			std::atomic<std::uint64_t>& slot = m_slots[( home + probe ) & m_mask];
+			std::uint64_t seen = slot.load( std::memory_order_relaxed );
+
+			// empty, stale, or somebody already put our answer here
+			if ( seen == 0 || ( seen >> GENERATION_SHIFT ) != generation || ( seen & KEY_MASK ) == key ) {
+
+				if ( slot.compare_exchange_strong( seen, entry, std::memory_order_release ) ) {
+					return;
+				}
+			}
+		}
+
+		// full up; it's a cache, so somebody gets bumped
+		m_slots[home].store( entry, std::memory_order_release );
+	}
+
+	const std::size_t m_mask;
+	std::unique_ptr<std::atomic<std::uint64_t>[]> m_slots;
+	const bool m_followRegistry;
+	std::atomic<std::uint64_t> m_generation;
+	std::atomic<unsigned> m_registeredTypes;
+};
+
+#endif
@@ -0,0 +1,838 @@
+#ifndef RTTI_H
+#define RTTI_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <type_traits>
+
+#include "instrumentation.h"
+
+class RTTI;
+
+// The weak section bounds behind RTTI_DEFINE's list of static types: see the
+// registry below. Turn it off with -DRTTI_NO_SECTIONS and every RTTI_DEFINE
+// registers itself during static init instead, same as it used to.
+#if defined( __ELF__ ) && !defined( RTTI_NO_SECTIONS )
+#define RTTI_USE_SECTIONS 1
+extern "C" const RTTI* const __start_rtti_types[] __attribute__(( weak ));
+extern "C" const RTTI* const __stop_rtti_types[] __attribute__(( weak ));
+#endif
+
+// C++20 checks RTTI_DEFINE descriptors really are built at compile time
+#if defined( __cpp_constinit )
+#define RTTI_CONSTINIT constinit
+#else
+#define RTTI_CONSTINIT
+#endif
+
+/**
+ * 	THE BITS OF A TYPE THAT CHANGE
+ *
+ * 	Its index, once the registry hands one out, and the ancestor bitset and
+ * 	offset table, once somebody asks. The descriptor itself never changes,
+ * 	so it's constexpr and can sit in read-only data; this is the one
+ * 	writable bit, kept off to the side. For RTTI_DEFINE types it's a static
+ * 	with nothing to run at startup and nothing to tear down at exit.
+ *
+ * 	The bitset and table are allocated the first time they're built and
+ * 	static types never give them back. ancestorBits and ancestorWords are
+ * 	the bitset's words, so derivesFrom needn't go through the vector.
+ */
+// hot fields first, on one cache line: a cast reads index, ancestorBits,
+// ancestorWords and offsets and nothing else
+struct alignas( 64 ) RTTIState {
+	static constexpr unsigned UNASSIGNED = ~0u;
+
+	constexpr RTTIState() : index( UNASSIGNED ), ancestorBits( nullptr ), ancestorWords( 0 ), offsets( nullptr ), ancestors( nullptr ) {}
+
+	RTTIState( const RTTIState& ) = delete;
+	RTTIState& operator=( const RTTIState& ) = delete;
+
+	std::atomic<unsigned> index;
+	std::atomic<const std::uint64_t*> ancestorBits;
+	std::size_t ancestorWords; // set before ancestorBits is
+	std::atomic<const std::ptrdiff_t*> offsets;
+
+	std::atomic<const std::vector<std::uint64_t>*> ancestors;
+	std::once_flag ancestorsOnce;
+	std::once_flag offsetsOnce;
+};
+
+/**
+ * 	NAME HASHES
+ *
+ * 	32-bit FNV-1a of a class name. constexpr, so RTTI_DEFINE bakes it in
+ * 	at compile time, and anything that writes type tags to disk can too.
+ * 	The value is part of the file formats that use it, so don't change it.
+ */
+constexpr std::uint32_t rtti_name_hash( const char* name ) {
+
+	std::uint32_t hash = 2166136261u;
+	for ( ; *name; ++name ) {
+		hash = ( hash ^ static_cast<unsigned char>( *name ) ) * 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * 	TYPE REGISTRY, A NUMBER FOR EVERYBODY
+ *
+ * 	Every RTTI gets a dense index. The indices are what the ancestor
+ * 	bitsets are made of.
+ *
+ * 	RTTI_DEFINE types don't do anything at startup to get theirs. Each one
+ * 	drops a pointer to itself in the rtti_types section, and the linker
+ * 	gathers them up between __start_rtti_types and __stop_rtti_types. The
+ * 	first call into the registry walks that list and numbers the lot (in
+ * 	link order), so listing them works even if nothing's touched them yet.
+ * 	A type that isn't on the list (one in a shared library, say, which has
+ * 	a list of its own, or a template spelling out its own typeInfo) gets
+ * 	registered the first time its index is asked for.
+ *
+ * 	DynamicRTTI types register when they're constructed and drop out when
+ * 	they're destroyed.
+ *
+ * 	Every live RTTI is also in here, so types can be looked up by
+ * 	index or by class name, or listed, from any thread, while other
+ * 	threads register or drop types (plugins, content reloads, ...).
+ *
+ * 	Lookups never lock. The index side is an append-only directory of
+ * 	fixed-size chunks that never move. The name side is an open-addressing
+ * 	hash table of atomic pointers; when it fills up, the writer builds
+ * 	a bigger copy off to the side and swaps it in with one atomic store,
+ * 	RCU-style, so readers see either the old table or the new one.
+ * 	Old tables stick around (they only ever double, so that's at most
+ * 	as much again) because a reader might still be looking at one.
+ *
+ * 	The name table is keyed on each type's precomputed name hash, so
+ * 	turning a stored hash back into a type is one probe and no string
+ * 	compares.
+ *
+ * 	Writers take a lock, but only against each other.
+ * 	Class names are expected to be unique, and so are their hashes.
+ * 	With duplicate names, find returns one of them. Two different names
+ * 	with the same hash would have findByHash (and whatever reads type
+ * 	tags back off disk) quietly handing out the wrong type, so that
+ * 	aborts with both names when the second one registers. Rename one.
+ */
+class RTTIRegistry {
+public:
+	static unsigned typeCount() {
+
+		enrolStaticTypes();
+		return counter().load( std::memory_order_acquire );
+	}
+
+	// the DynamicRTTI constructor and destructor take care of these
+	static void add( const RTTI* type );
+	static void remove( const RTTI* type );
+
+	// RTTI::getIndex comes here the first time, for types without one yet
+	static unsigned enrol( const RTTI* type );
+
+	// null if there's no live type by that index or name
+	static const RTTI* find( unsigned index );
+	static const RTTI* find( const char* className );
+
+	// the type whose getNameHash() is this, for reading back type tags
+	static const RTTI* findByHash( std::uint32_t nameHash );
+
+	// every live type, in index order
+	template<typename Fn>
+	static void forEach( Fn fn ) {
+
+		const unsigned count = typeCount();
+		for ( unsigned i = 0; i < count; ++i ) {
+
+			if ( const RTTI* type = find( i ) ) {
+				fn( *type );
+			}
+		}
+	}
+
+private:
+	static const unsigned CHUNK_BITS = 10;
+	static const unsigned CHUNK_SIZE = 1u << CHUNK_BITS;
+	static const unsigned MAX_CHUNKS = 4096;
+
+	typedef std::atomic<const RTTI*> Slot;
+
+	struct NameTable {
+		explicit NameTable( std::size_t capacity ) : mask( capacity - 1 ), used( 0 ), slots( new Slot[capacity] ) {
+			for ( std::size_t i = 0; i < capacity; ++i ) {
+				slots[i].store( nullptr, std::memory_order_relaxed );
+			}
+		}
+
+		const std::size_t mask;
+		std::size_t used; // live ones and tombstones
+		std::unique_ptr<Slot[]> slots;
+	};
+
+	struct State {
+		State() : staticTypesEnrolled( false ), names( new NameTable( 64 ) ) {
+			for ( unsigned i = 0; i < MAX_CHUNKS; ++i ) {
+				chunks[i].store( nullptr, std::memory_order_relaxed );
+			}
+		}
+
+		std::mutex writeMutex;
+		std::atomic<bool> staticTypesEnrolled;
+		std::atomic<Slot*> chunks[MAX_CHUNKS];
+		std::atomic<NameTable*> names;
+		std::vector<std::unique_ptr<Slot[]>> ownedChunks;
+		std::vector<std::unique_ptr<NameTable>> ownedTables;
+	};
+
+	static std::atomic<unsigned>& counter() {
+
+		static std::atomic<unsigned> s_counter( 0 );
+		return s_counter;
+	}
+
+	// never destroyed, so statics being torn down at exit can still unregister
+	static State& state() {
+
+		static State* s_state = new State();
+		return *s_state;
+	}
+
+	// a slot that used to hold a type; lookups keep probing past it
+	static const RTTI* tombstone() {
+
+		static const char s_tombstone = 0;
+		return reinterpret_cast<const RTTI*>( &s_tombstone );
+	}
+
+	static void enrolStaticTypes();
+
+	// numbers the type and files it; the caller holds writeMutex
+	static void insert( State& s, const RTTI* type );
+	static void insertName( NameTable& table, const RTTI* type );
+};
+
+/**
+ * 	RTTI ALL UP IN THIS HIZZY
+ *
+ * 	A descriptor is a name, a hash, a span of parents somewhere static and
+ * 	a pointer to its RTTIState, all fixed when it's built. The constructor
+ * 	is constexpr and there's no destructor to speak of, so RTTI_DEFINE's
+ * 	are constant-initialised: no startup work, nothing for the static
+ * 	init order to get wrong, and nothing on the page that ever changes.
+ */
+class RTTI {
+
+public:
+	// Fills offsets[i] with the byte offset of the subobject with type index i
+	// inside a complete object. Only types that exist in C++ have one of these.
+	typedef void (*OffsetRecorder)( const void* complete, std::ptrdiff_t* offsets );
+
+	// offset slots for types that aren't ancestors, or show up more than once
+	static constexpr std::ptrdiff_t NO_OFFSET = PTRDIFF_MIN;
+	static constexpr std::ptrdiff_t AMBIGUOUS_OFFSET = PTRDIFF_MIN + 1;
+
+	// RTTI_DEFINE types point straight at the static parent array and state
+	// in their RTTIInfo. No allocation, and the name hash comes precomputed.
+	// The type registers itself when its index is first needed.
+	constexpr RTTI( const char* className, std::uint32_t nameHash, const RTTI* const* parents, unsigned parentCount,
+		OffsetRecorder recorder, RTTIState* state )
+		: m_className( className )
+		  , m_nameHash( nameHash )
+		  , m_parents( parents )
+		  , m_parentCount( parentCount )
+		  , m_recorder( recorder )
+		  , m_state( state )
+	{}
+
+	// descriptors are compared by identity, so no copying 'em
+	RTTI( const RTTI& ) = delete;
+	RTTI& operator=( const RTTI& ) = delete;
+
+	const char* getClassName() const {
+
+		return m_className;
+	}
+
+	// rtti_name_hash( getClassName() )
+	std::uint32_t getNameHash() const {
+
+		return m_nameHash;
+	}
+
+	// Everything on the section list has its index by the first registry
+	// call, so the branch is all but never taken; enrolling is out of line.
+	unsigned getIndex() const {
+
+		const unsigned index = m_state->index.load( std::memory_order_relaxed );
+		if ( __builtin_expect( index == RTTIState::UNASSIGNED, 0 ) ) {
+			return enrol();
+		}
+		return index;
+	}
+
+	unsigned getParentCount() const {
+
+		return m_parentCount;
+	}
+
+	const RTTI& getParent( unsigned i ) const {
+
+		return *m_parents[i];
+	}
+
+	// one bit test, no matter how deep or diamond-y the hierarchy gets
+	bool derivesFrom( const RTTI& r ) const {
+
+		INSTRUMENT_SCOPE( DERIVES_FROM );
+		const std::uint64_t* ancestors = m_state->ancestorBits.load( std::memory_order_acquire );
+		if ( __builtin_expect( !ancestors, 0 ) ) {
+			ancestors = firstAncestors();
+		}
+
+		const unsigned index = r.getIndex();
+		const unsigned word = index / 64;
+
+		return word < m_state->ancestorWords
+			&& ( ( ancestors[word] >> ( index % 64 ) ) & 1 );
+	}
+
+	// bit i is set if this type is, or derives from, the type with index i.
+	// built lazily on first query so parents defined later in static init still count
+	const std::vector<std::uint64_t>& getAncestors() const {
+
+		const std::vector<std::uint64_t>* ancestors = m_state->ancestors.load( std::memory_order_acquire );
+		if ( !ancestors ) {
+
+			std::call_once( m_state->ancestorsOnce, [this] { buildAncestors(); } );
+			ancestors = m_state->ancestors.load( std::memory_order_acquire );
+		}
+
+		return *ancestors;
+	}
+
+	// Subobject offsets for a complete object of this type, indexed by type index.
+	// Virtual base offsets can only be read off a real object,
+	// so the table is null until the first cast hands one over.
+	const std::ptrdiff_t* getOffsets() const {
+
+		return m_state->offsets.load( std::memory_order_acquire );
+	}
+
+	// once per type, so it stays out of rtti_cast's way
+	__attribute__(( noinline, cold )) const std::ptrdiff_t* buildOffsets( const void* complete ) const {
+
+		std::call_once( m_state->offsetsOnce, [this, complete] {
+
+			std::size_t size = 0;
+			const std::vector<std::uint64_t>& ancestors = getAncestors();
+			for ( std::size_t bit = 0; bit < ancestors.size() * 64; ++bit ) {
+
+				if ( ( ancestors[bit / 64] >> ( bit % 64 ) ) & 1 ) {
+
+					size = bit + 1;
+				}
+			}
+
+			std::ptrdiff_t* offsets = new std::ptrdiff_t[size ? size : 1];
+			std::fill( offsets, offsets + size, NO_OFFSET );
+			if ( m_recorder ) {
+
+				m_recorder( complete, offsets );
+			}
+
+			m_state->offsets.store( offsets, std::memory_order_release );
+		} );
+
+		return getOffsets();
+	}
+
+protected:
+	// for DynamicRTTI, which does go away
+	void releaseState() const {
+
+		m_state->ancestorBits.store( nullptr, std::memory_order_relaxed );
+		delete m_state->ancestors.exchange( nullptr, std::memory_order_relaxed );
+		delete[] m_state->offsets.exchange( nullptr, std::memory_order_relaxed );
+	}
+
+private:
+	friend class RTTIRegistry;
+
+	// the slow halves of getIndex and derivesFrom, kept out of their way
+	__attribute__(( noinline, cold )) unsigned enrol() const {
+
+		return RTTIRegistry::enrol( this );
+	}
+
+	__attribute__(( noinline, cold )) const std::uint64_t* firstAncestors() const {
+
+		return getAncestors().data();
+	}
+
+	void buildAncestors() const {
+
+		const unsigned index = getIndex();
+		std::vector<std::uint64_t>* ancestors = new std::vector<std::uint64_t>( index / 64 + 1, 0 );
+		( *ancestors )[index / 64] |= std::uint64_t( 1 ) << ( index % 64 );
+
+		for ( unsigned i = 0; i < m_parentCount; ++i ) {
+
+			const std::vector<std::uint64_t>& inherited = m_parents[i]->getAncestors();
+
+			if ( inherited.size() > ancestors->size() ) {
+
+				ancestors->resize( inherited.size(), 0 );
+			}
+
+			for ( std::size_t word = 0; word < inherited.size(); ++word ) {
+
+				( *ancestors )[word] |= inherited[word];
+			}
+		}
+
+		m_state->ancestorWords = ancestors->size();
+		m_state->ancestorBits.store( ancestors->data(), std::memory_order_release );
+		m_state->ancestors.store( ancestors, std::memory_order_release );
+	}
+
+	const char* const m_className;
+	const std::uint32_t m_nameHash;
+	const RTTI* const* const m_parents;
+	const unsigned m_parentCount;
+	const OffsetRecorder m_recorder;
+	RTTIState* const m_state;
+};
+
+// The parents of a runtime-built type come in a list that might not outlive
+// it, and it needs state of its own, so this holds both. It's a base class
+// so it's built before the RTTI that points into it.
+class DynamicRTTIStorage {
+protected:
+	explicit DynamicRTTIStorage( const std::vector<const RTTI*>& parents ) : m_ownedParents( parents ) {}
+
+	const std::vector<const RTTI*> m_ownedParents;
+	RTTIState m_ownedState;
+};
+
+/**
+ * 	TYPES MADE UP AT RUNTIME
+ *
+ * 	Plugins, loaded content and the like. These are built the
+ * 	old-fashioned way, registered straight off and unregistered
+ * 	when they go.
+ */
+class DynamicRTTI : private DynamicRTTIStorage, public RTTI {
+public:
+	DynamicRTTI( const char* className, const std::vector<const RTTI*>& parents, OffsetRecorder recorder = nullptr )
+		: DynamicRTTIStorage( parents )
+		  , RTTI( className, rtti_name_hash( className ), m_ownedParents.data(),
+			static_cast<unsigned>( m_ownedParents.size() ), recorder, &m_ownedState )
+	{
+		RTTIRegistry::add( this );
+	}
+
+	~DynamicRTTI() {
+
+		RTTIRegistry::remove( this );
+		releaseState();
+	}
+};
+
+/**
+ * 	REGISTRY GUTS
+ */
+inline void RTTIRegistry::insertName( NameTable& table, const RTTI* type ) {
+
+	for ( std::size_t i = type->getNameHash() & table.mask; ; i = ( i + 1 ) & table.mask ) {
+
+		const RTTI* entry = table.slots[i].load( std::memory_order_relaxed );
+		if ( entry && entry != tombstone() && entry->getNameHash() == type->getNameHash()
+		     && std::strcmp( entry->getClassName(), type->getClassName() ) != 0 ) {
+
+			std::fprintf( stderr, "RTTI: \"%s\" and \"%s\" have the same name hash (%08x)\n",
+				entry->getClassName(), type->getClassName(), unsigned( type->getNameHash() ) );
+			std::abort();
+		}
+
+		if ( !entry ) {
+
+			table.slots[i].store( type, std::memory_order_release );
+			++table.used;
+			return;
+		}
+	}
+}
+
+inline void RTTIRegistry::add( const RTTI* type ) {
+
+	enrolStaticTypes();
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.writeMutex );
+	insert( s, type );
+}
+
+inline unsigned RTTIRegistry::enrol( const RTTI* type ) {
+
+	enrolStaticTypes();
+
+	unsigned index = type->m_state->index.load( std::memory_order_acquire );
+	if ( index == RTTIState::UNASSIGNED ) {
+
+		State& s = state();
+		std::lock_guard<std::mutex> lock( s.writeMutex );
+
+		// somebody else might've got there first
+		if ( type->m_state->index.load( std::memory_order_relaxed ) == RTTIState::UNASSIGNED ) {
+			insert( s, type );
+		}
+		index = type->m_state->index.load( std::memory_order_relaxed );
+	}
+
+	return index;
+}
+
+// Numbers everything RTTI_DEFINE put in the section, once.
+inline void RTTIRegistry::enrolStaticTypes() {
+
+#if defined( RTTI_USE_SECTIONS )
+	State& s = state();
+	if ( s.staticTypesEnrolled.load( std::memory_order_acquire ) ) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( s.writeMutex );
+	if ( !s.staticTypesEnrolled.load( std::memory_order_relaxed ) ) {
+
+		for ( const RTTI* const* entry = __start_rtti_types; entry != __stop_rtti_types; ++entry ) {
+
+			if ( ( *entry )->m_state->index.load( std::memory_order_relaxed ) == RTTIState::UNASSIGNED ) {
+				insert( s, *entry );
+			}
+		}
+
+		s.staticTypesEnrolled.store( true, std::memory_order_release );
+	}
+#endif
+}
+
+inline void RTTIRegistry::insert( State& s, const RTTI* type ) {
+
+	// by index
+	const unsigned index = counter().load( std::memory_order_relaxed );
+	type->m_state->index.store( index, std::memory_order_release );
+	const unsigned chunk = index >> CHUNK_BITS;
+	if ( chunk < MAX_CHUNKS ) {
+
+		Slot* slots = s.chunks[chunk].load( std::memory_order_relaxed );
+		if ( !slots ) {
+
+			slots = new Slot[CHUNK_SIZE];
+			for ( unsigned i = 0; i < CHUNK_SIZE; ++i ) {
+				slots[i].store( nullptr, std::memory_order_relaxed );
+			}
+			s.ownedChunks.emplace_back( slots );
+			s.chunks[chunk].store( slots, std::memory_order_release );
+		}
+
+		slots[index & ( CHUNK_SIZE - 1 )].store( type, std::memory_order_release );
+	}
+
+	// by name, growing the table off to the side if it's over half full
+	NameTable* table = s.names.load( std::memory_order_relaxed );
+	if ( ( table->used + 1 ) * 2 > table->mask + 1 ) {
+
+		std::size_t live = 0;
+		for ( std::size_t i = 0; i <= table->mask; ++i ) {
+
+			const RTTI* entry = table->slots[i].load( std::memory_order_relaxed );
+			live += entry && entry != tombstone();
+		}
+
+		std::size_t capacity = table->mask + 1;
+		while ( ( live + 1 ) * 4 > capacity ) {
+			capacity *= 2;
+		}
+
+		NameTable* bigger = new NameTable( capacity );
+		for ( std::size_t i = 0; i <= table->mask; ++i ) {
+
+			const RTTI* entry = table->slots[i].load( std::memory_order_relaxed );
+			if ( entry && entry != tombstone() ) {
+				insertName( *bigger, entry );
+			}
+		}
+
+		s.ownedTables.emplace_back( bigger );
+		s.names.store( bigger, std::memory_order_release );
+		table = bigger;
+	}
+
+	insertName( *table, type );
+
+	// last, so anybody who sees the count can find the type
+	counter().store( index + 1, std::memory_order_release );
+}
+
+inline void RTTIRegistry::remove( const RTTI* type ) {
+
+	State& s = state();
+	std::lock_guard<std::mutex> lock( s.writeMutex );
+
+	const unsigned index = type->m_state->index.load( std::memory_order_relaxed );
+	if ( ( index >> CHUNK_BITS ) < MAX_CHUNKS ) {
+
+		Slot* slots = s.chunks[index >> CHUNK_BITS].load( std::memory_order_relaxed );
+		slots[index & ( CHUNK_SIZE - 1 )].store( nullptr, std::memory_order_release );
+	}
+
+	NameTable* table = s.names.load( std::memory_order_relaxed );
+	for ( std::size_t i = type->getNameHash() & table->mask; ; i = ( i + 1 ) & table->mask ) {
+
+		const RTTI* entry = table->slots[i].load( std::memory_order_relaxed );
+		if ( !entry ) {
+			return;
+		}
+
+		if ( entry == type ) {
+			table->slots[i].store( tombstone(), std::memory_order_release );
+			return;
+		}
+	}
+}
+
+inline const RTTI* RTTIRegistry::find( unsigned index ) {
+
+	enrolStaticTypes();
+
+	if ( ( index >> CHUNK_BITS ) >= MAX_CHUNKS ) {
+		return nullptr;
+	}
+
+	const Slot* slots = state().chunks[index >> CHUNK_BITS].load( std::memory_order_acquire );
+	return slots ? slots[index & ( CHUNK_SIZE - 1 )].load( std::memory_order_acquire ) : nullptr;
+}
+
+inline const RTTI* RTTIRegistry::find( const char* className ) {
+
+	enrolStaticTypes();
+
+	const std::uint32_t hash = rtti_name_hash( className );
+	const NameTable* table = state().names.load( std::memory_order_acquire );
+	for ( std::size_t i = hash & table->mask; ; i = ( i + 1 ) & table->mask ) {
+
+		const RTTI* entry = table->slots[i].load( std::memory_order_acquire );
+		if ( !entry ) {
+			return nullptr;
+		}
+
+		if ( entry != tombstone() && entry->getNameHash() == hash && std::strcmp( entry->getClassName(), className ) == 0 ) {
+			return entry;
+		}
+	}
+}
+
+inline const RTTI* RTTIRegistry::findByHash( std::uint32_t nameHash ) {
+
+	enrolStaticTypes();
+
+	const NameTable* table = state().names.load( std::memory_order_acquire );
+	for ( std::size_t i = nameHash & table->mask; ; i = ( i + 1 ) & table->mask ) {
+
+		const RTTI* entry = table->slots[i].load( std::memory_order_acquire );
+		if ( !entry ) {
+			return nullptr;
+		}
+
+		if ( entry != tombstone() && entry->getNameHash() == nameHash ) {
+			return entry;
+		}
+	}
+}
+
+/**
+ * 	VARIADIC TEMPLATE MONSTROSITY
+ */
+template<typename... Types>
+struct RTTITypeList {};
+
+// RTTI_DEFINE specializes this to inherit from the type's RTTIInfo,
+// which hands the parent pack over to the compile-time checks below
+template<typename T>
+struct RTTIInfoOf;
+
+template<typename Derived, typename... Parents>
+class RTTIInfo {
+public:
+	typedef RTTITypeList<Parents...> ParentList;
+
+	static constexpr unsigned parentCount = sizeof...(Parents);
+
+	// build list from expansion of variadic parents
+	// (with a null on the end so parentless types don't get a zero-sized array)
+	static constexpr const RTTI* parents[sizeof...(Parents) + 1] = { &Parents::typeInfo..., nullptr };
+
+	// the type's index, bitset and offsets; constant-initialised like the rest
+	static inline RTTIState runtimeState;
+
+	static void recordCompleteOffsets( const void* complete, std::ptrdiff_t* offsets ) {
+
+		recordOffsets( static_cast<const char*>( complete ), static_cast<const Derived*>( complete ), offsets );
+	}
+
+	// walks the parent packs, letting static_cast do the virtual base lookups
+	static void recordOffsets( const char* complete, const Derived* self, std::ptrdiff_t* offsets ) {
+
+		std::ptrdiff_t& slot = offsets[Derived::typeInfo.getIndex()];
+		const std::ptrdiff_t offset = reinterpret_cast<const char*>( self ) - complete;
+
+		// a virtual base turns up once per path but always at the same spot,
+		// a repeated non-virtual base is ambiguous and can't be cast to
+		if ( slot == RTTI::NO_OFFSET || slot == offset ) {
+
+			slot = offset;
+		}
+		else {
+
+			slot = RTTI::AMBIGUOUS_OFFSET;
+		}
+
+		( RTTIInfoOf<Parents>::recordOffsets( complete, static_cast<const Parents*>( self ), offsets ), ... );
+	}
+};
+
+/**
+ * 	COMPILE-TIME DERIVES-FROM, NO CHARGE
+ */
+template<typename Derived, typename Base>
+struct rtti_derives;
+
+template<typename ParentList, typename Base>
+struct rtti_any_derives;
+
+template<typename Base>
+struct rtti_any_derives<RTTITypeList<>, Base> : std::false_type {};
+
+template<typename First, typename... Rest, typename Base>
+struct rtti_any_derives<RTTITypeList<First, Rest...>, Base>
+	: std::integral_constant<bool,
+		rtti_derives<First, Base>::value
+		|| rtti_any_derives<RTTITypeList<Rest...>, Base>::value> {};
+
+template<typename Derived, typename Base>
+struct rtti_derives
+	: std::integral_constant<bool,
+		std::is_same<typename std::remove_cv<Derived>::type, typename std::remove_cv<Base>::type>::value
+		|| rtti_any_derives<typename RTTIInfoOf<typename std::remove_cv<Derived>::type>::ParentList, Base>::value> {};
+
+template<typename Derived, typename Base>
+constexpr bool rtti_derives_v = rtti_derives<Derived, Base>::value;
+
+// Does the object derive from Base?
+// If its static type already does, this is a constant and the
+// virtual call never happens. Otherwise it's the runtime bit test.
+// (object must not be null)
+template<typename Base, typename T>
+inline bool derivesFrom( const T* object ) {
+
+	return rtti_derives_v<T, Base>
+		|| object->getTypeInfo().derivesFrom( Base::typeInfo );
+}
+
+/**
+ * 	RTTI_CAST, DYNAMIC_CAST'S COOLER COUSIN
+ *
+ * 	Works like dynamic_cast on pointers: up, down and sideways,
+ * 	through virtual bases too. Returns null when it doesn't fit
+ * 	or when the target base is ambiguous.
+ *
+ * 	The type check is the bit test. The adjustment is two loads from
+ * 	the dynamic type's offset table: back to the complete object,
+ * 	then forward to the target.
+ */
+template<typename TargetPtr, typename Source>
+inline TargetPtr rtti_cast( Source* object ) {
+
+	static_assert( std::is_pointer<TargetPtr>::value, "rtti_cast only does pointers" );
+	typedef typename std::remove_pointer<TargetPtr>::type Target;
+	static_assert( std::is_const<Target>::value || !std::is_const<Source>::value, "rtti_cast can't cast away const" );
+
+	if ( !object ) {
+
+		return nullptr;
+	}
+
+	// upcasts are the compiler's problem
+	if constexpr ( rtti_derives_v<Source, Target> ) {
+
+		return object;
+	}
+	else {
+
+		INSTRUMENT_SCOPE( SIDE_CAST );
+
+		const RTTI& type = object->getTypeInfo();
+		if ( !type.derivesFrom( Target::typeInfo ) ) {
+
+			return nullptr;
+		}
+
+		const std::ptrdiff_t* offsets = type.getOffsets();
+		if ( !offsets ) {
+
+			offsets = type.buildOffsets( object->getRTTIObject() );
+		}
+
+		const std::ptrdiff_t from = offsets[std::remove_cv<Source>::type::typeInfo.getIndex()];
+		const std::ptrdiff_t to = offsets[Target::typeInfo.getIndex()];
+		if ( from < 0 || to < 0 ) {
+
+			return nullptr;
+		}
+
+		const char* complete = reinterpret_cast<const char*>( object ) - from;
+		return reinterpret_cast<TargetPtr>( const_cast<char*>( complete + to ) );
+	}
+}
+
+/**
+ * 	MACRO HELPER REPRESENT
+ *
+ * 	Every class in a hierarchy needs RTTI_DECLARE so the most-derived
+ * 	getRTTIObject returns the complete object.
+ */
+#define RTTI_DECLARE() \
+	public: static const RTTI typeInfo; \
+	public: virtual const RTTI& getTypeInfo() const { return typeInfo; } \
+	public: virtual const void* getRTTIObject() const { return this; }
+
+// Everything in here is a constant, so the descriptor is built by the
+// compiler, not at startup. RTTI_ENROL puts it on the registry's list.
+#define RTTI_DEFINE(ThisClass, Parents...) \
+	template<> struct RTTIInfoOf<ThisClass> : RTTIInfo<ThisClass, ##Parents> {}; \
+	RTTI_CONSTINIT const RTTI ThisClass::typeInfo( #ThisClass, std::integral_constant<std::uint32_t, rtti_name_hash( #ThisClass )>::value, \
+		RTTIInfoOf<ThisClass>::parents, RTTIInfoOf<ThisClass>::parentCount, &RTTIInfoOf<ThisClass>::recordCompleteOffsets, \
+		&RTTIInfoOf<ThisClass>::runtimeState ); \
+	RTTI_ENROL( ThisClass )
+
+#define RTTI_CONCAT_INNER(a, b) a##b
+#define RTTI_CONCAT(a, b) RTTI_CONCAT_INNER(a, b)
+
+// a pointer in the rtti_types section, or without sections, a registration at static init
+#if defined( RTTI_USE_SECTIONS )
+#define RTTI_ENROL(ThisClass) \
+	static const RTTI* const RTTI_CONCAT( rtti_entry_, __COUNTER__ ) __attribute__(( used, section( "rtti_types" ) )) = &ThisClass::typeInfo;
+#else
+#define RTTI_ENROL(ThisClass) \
+	static const unsigned RTTI_CONCAT( rtti_entry_, __COUNTER__ ) = ThisClass::typeInfo.getIndex();
+#endif
+
+#endif
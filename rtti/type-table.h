@@ -0,0 +1,179 @@
+#ifndef RTTI_TYPE_TABLE_H
+#define RTTI_TYPE_TABLE_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#include "rtti.h"
+
+/**
+ * 	ONE TABLE TO RULE THEM ALL
+ *
+ * 	The closed-world mode. List every type up front and the
+ * 	descriptors, the parent edges and the ancestor bitsets all get built
+ * 	at compile time from the RTTI_DEFINE parent packs, packed
+ * 	into one contiguous read-only block.
+ *
+ * 	Table indices are local to the table (0..size-1), so an object that
+ * 	stores one can be checked with a single load from the bitset block.
+ * 	Every parent of a listed type has to be listed too.
+ *
+ * 		typedef RTTITypeTable<StaffMember, Librarian, Teacher> StaffTypes;
+ * 		static_assert( StaffTypes::derivesFrom<Teacher, StaffMember>(), "" );
+ */
+template<typename... Types>
+class RTTITypeTable {
+public:
+	static constexpr unsigned size = sizeof...(Types);
+	static constexpr unsigned NOT_IN_TABLE = ~0u;
+	static constexpr unsigned words = ( size + 63 ) / 64;
+
+	static_assert( size > 0, "an empty type table isn't much of a table" );
+	static_assert( size <= 0xffff, "edges are stored as 16-bit indices" );
+
+	struct Descriptor {
+		const RTTI* type;
+		std::uint16_t firstParent;
+		std::uint16_t parentCount;
+	};
+
+	template<typename T>
+	static constexpr unsigned indexOf() {
+
+		constexpr bool matches[] = { std::is_same<T, Types>::value... };
+		for ( unsigned i = 0; i < size; ++i ) {
+
+			if ( matches[i] ) {
+
+				return i;
+			}
+		}
+
+		return NOT_IN_TABLE;
+	}
+
+	// one load and a mask, plus the range checks;
+	// false if either isn't a table index (NOT_IN_TABLE, say)
+	static constexpr bool derivesFrom( unsigned derived, unsigned base ) {
+
+		return derived < size && base < size
+			&& ( ( ancestors[derived * words + base / 64] >> ( base % 64 ) ) & 1 );
+	}
+
+	template<typename Derived, typename Base>
+	static constexpr bool derivesFrom() {
+
+		return derivesFrom( indexOf<Derived>(), indexOf<Base>() );
+	}
+
+	// Maps a descriptor back to its table index, for objects that only
+	// know their getTypeInfo(). Cold path; hang on to the answer.
+	static unsigned indexOf( const RTTI& type ) {
+
+		static const std::vector<unsigned> remap = buildRemap();
+		return type.getIndex() < remap.size() ? remap[type.getIndex()] : NOT_IN_TABLE;
+	}
+
+private:
+	template<typename T>
+	static constexpr unsigned parentCountOf() {
+
+		return RTTIInfoOf<T>::parentCount;
+	}
+
+	static constexpr unsigned edgeCount = ( 0 + ... + parentCountOf<Types>() );
+	static_assert( edgeCount <= 0xffff, "parent edges are stored as 16-bit offsets" );
+
+	template<typename... Parents>
+	static constexpr void appendParents( RTTITypeList<Parents...>, std::array<std::uint16_t, edgeCount + 1>& edges, std::size_t& at ) {
+
+		static_assert( ( ... && ( indexOf<Parents>() != NOT_IN_TABLE ) ), "every parent needs to be in the table" );
+		( ( edges[at++] = static_cast<std::uint16_t>( indexOf<Parents>() ) ), ... );
+	}
+
+	static constexpr std::array<std::uint16_t, edgeCount + 1> buildEdges() {
+
+		std::array<std::uint16_t, edgeCount + 1> edges{};
+		std::size_t at = 0;
+		( appendParents( typename RTTIInfoOf<Types>::ParentList(), edges, at ), ... );
+		return edges;
+	}
+
+	static constexpr std::array<Descriptor, size> buildDescriptors() {
+
+		std::array<Descriptor, size> result{ { { &Types::typeInfo, 0, 0 }... } };
+		constexpr unsigned counts[] = { parentCountOf<Types>()... };
+
+		std::uint16_t first = 0;
+		for ( unsigned i = 0; i < size; ++i ) {
+
+			result[i].firstParent = first;
+			result[i].parentCount = static_cast<std::uint16_t>( counts[i] );
+			first += counts[i];
+		}
+
+		return result;
+	}
+
+	// Keep OR-ing parents into children until nothing changes.
+	// The types can be listed in any order.
+	static constexpr std::array<std::uint64_t, size * words> buildAncestors() {
+
+		std::array<std::uint64_t, size * words> bits{};
+		for ( unsigned i = 0; i < size; ++i ) {
+
+			bits[i * words + i / 64] |= std::uint64_t( 1 ) << ( i % 64 );
+		}
+
+		bool changed = true;
+		while ( changed ) {
+
+			changed = false;
+			for ( unsigned i = 0; i < size; ++i ) {
+
+				for ( unsigned e = 0; e < descriptors[i].parentCount; ++e ) {
+
+					const unsigned parent = edges[descriptors[i].firstParent + e];
+					for ( unsigned w = 0; w < words; ++w ) {
+
+						const std::uint64_t merged = bits[i * words + w] | bits[parent * words + w];
+						if ( merged != bits[i * words + w] ) {
+
+							bits[i * words + w] = merged;
+							changed = true;
+						}
+					}
+				}
+			}
+		}
+
+		return bits;
+	}
+
+	static std::vector<unsigned> buildRemap() {
+
+		std::vector<unsigned> remap;
+		for ( unsigned i = 0; i < size; ++i ) {
+
+			const unsigned index = descriptors[i].type->getIndex();
+			if ( index >= remap.size() ) {
+
+				remap.resize( index + 1, NOT_IN_TABLE );
+			}
+			remap[index] = i;
+		}
+
+		return remap;
+	}
+
+public:
+	// the table itself, in order: descriptors, parent edges, ancestor bits
+	static constexpr std::array<Descriptor, size> descriptors = buildDescriptors();
+	static constexpr std::array<std::uint16_t, edgeCount + 1> edges = buildEdges();
+	static constexpr std::array<std::uint64_t, size * words> ancestors = buildAncestors();
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef RTTI_TYPE_TAG_H
+#define RTTI_TYPE_TAG_H
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <utility>
+
+#include "rtti.h"
+
+/**
+ * 	TYPE TAGS, RIGHT THERE IN THE OBJECT
+ *
+ * 	getTypeInfo() is a virtual call. When all you want is "what are you",
+ * 	that's a trip through the vtable for something that could be sitting
+ * 	in the object itself.
+ *
+ * 	So derive from RTTITagged and every object carries its type's dense
+ * 	registry index as a 16-bit tag. Reading it is one load, and it's a
+ * 	fine array index for buckets and per-type tables.
+ *
+ * 	Don't derive from it directly, though: go through RTTITaggedAs below,
+ * 	which does the tagging. In debug builds getTypeTag() checks the tag
+ * 	against getTypeInfo(), so a class that skipped RTTITaggedAs (and so
+ * 	still has its parent's tag) trips an assert instead of being quietly
+ * 	filed as its parent. Types past index 0xfffe get NO_TAG, and
+ * 	rtti_tag_is falls back to getTypeInfo() for those.
+ */
+class RTTITagged {
+public:
+	static constexpr std::uint16_t NO_TAG = 0xffff;
+
+	std::uint16_t getTypeTag() const {
+
+		assert( m_typeTag == ( getTypeInfo().getIndex() < NO_TAG ? getTypeInfo().getIndex() : NO_TAG )
+			&& "tag doesn't match the type; derive through RTTITaggedAs" );
+		return m_typeTag;
+	}
+
+	// from RTTI_DECLARE
+	virtual const RTTI& getTypeInfo() const = 0;
+
+protected:
+	RTTITagged() : m_typeTag( NO_TAG ) {}
+	virtual ~RTTITagged() {}
+
+	// the tag belongs to the object's type, not its value,
+	// so copies start untagged and assignment leaves it alone
+	RTTITagged( const RTTITagged& ) : m_typeTag( NO_TAG ) {}
+	RTTITagged& operator=( const RTTITagged& ) { return *this; }
+
+	void tagAs( const RTTI& type ) {
+
+		m_typeTag = type.getIndex() < NO_TAG ? static_cast<std::uint16_t>( type.getIndex() ) : NO_TAG;
+	}
+
+private:
+	std::uint16_t m_typeTag;
+};
+
+/**
+ * 	TAGGING ON THE WAY IN
+ *
+ * 	Put it between a class and its parent, naming the class:
+ *
+ * 		class Shape : public RTTITaggedAs<Shape> { ... };
+ * 		class Rectangle : public RTTITaggedAs<Rectangle, Shape> { ... };
+ *
+ * 	Its constructor passes everything through to the parent and then tags
+ * 	the object as Derived. Bases are built first, so the most derived
+ * 	class has the last word, and no constructor has to remember to do it.
+ * 	Copies get tagged too, so copying a Square into a Rectangle makes a
+ * 	Rectangle.
+ */
+template<typename Derived, typename Base = RTTITagged>
+class RTTITaggedAs : public Base {
+protected:
+	template<typename... Args>
+	RTTITaggedAs( Args&&... args ) : Base( std::forward<Args>( args )... ) {
+
+		this->tagAs( Derived::typeInfo );
+	}
+
+	RTTITaggedAs( const RTTITaggedAs& other ) : Base( other ) {
+
+		this->tagAs( Derived::typeInfo );
+	}
+
+	RTTITaggedAs( RTTITaggedAs&& other ) : Base( std::move( other ) ) {
+
+		this->tagAs( Derived::typeInfo );
+	}
+
+	RTTITaggedAs& operator=( const RTTITaggedAs& ) = default;
+	RTTITaggedAs& operator=( RTTITaggedAs&& ) = default;
+};
+
+/**
+ * 	EVERYBODY WHO DERIVES FROM X
+ *
+ * 	The ancestor bitsets turned inside out: one bit per type tag, set if
+ * 	that type is or derives from the base. Room for every possible tag,
+ * 	so "is this a Rectangle or a subtype" is one load of the tag, one load
+ * 	and mask of the word, and a compare. No bounds checks, no virtual calls.
+ *
+ * 	The set is worked out when it's built, so types registered after that
+ * 	(plugins, ...) aren't in it until refresh().
+ */
+class RTTITagSet {
+public:
+	explicit RTTITagSet( const RTTI& base ) : m_base( base ), m_bits( new std::uint64_t[WORDS] ) {
+
+		refresh();
+	}
+
+	void refresh() {
+
+		for ( std::size_t i = 0; i < WORDS; ++i ) {
+			m_bits[i] = 0;
+		}
+
+		RTTIRegistry::forEach( [this]( const RTTI& type ) {
+
+			if ( type.getIndex() < RTTITagged::NO_TAG && type.derivesFrom( m_base ) ) {
+				m_bits[type.getIndex() / 64] |= std::uint64_t( 1 ) << ( type.getIndex() % 64 );
+			}
+		} );
+	}
+
+	bool contains( std::uint16_t tag ) const {
+
+		return ( m_bits[tag >> 6] >> ( tag & 63 ) ) & 1;
+	}
+
+	const RTTI& base() const {
+
+		return m_base;
+	}
+
+private:
+	static const std::size_t WORDS = 65536 / 64;
+
+	const RTTI& m_base;
+	std::unique_ptr<std::uint64_t[]> m_bits;
+};
+
+// Is the object in the set? The tag when there is one, getTypeInfo() when there isn't.
+template<typename T>
+inline bool rtti_tag_is( const T* object, const RTTITagSet& set ) {
+
+	const std::uint16_t tag = object->getTypeTag();
+	return tag != RTTITagged::NO_TAG ? set.contains( tag ) : object->getTypeInfo().derivesFrom( set.base() );
+}
+
+#endif
@@ -1,69 +1,15 @@
-#include <vector>
 #include <iostream>
-#include <typeinfo>
+#include <string>
 #include <cassert>
+#include <thread>
+#include <vector>
 
-using namespace std;
-
-/**
- * 	RTTI ALL UP IN THIS HIZZY
- */
-class RTTI {
-
-public:
-	RTTI( const char* className, const std::vector<const RTTI*>& parents )
-		: m_className( className )
-		  , m_parents( parents )
-	{}
-
-	const char* getClassName() const {
-
-		return m_className;
-	}
-
-	bool derivesFrom( const RTTI& r ) const {
-
-		if ( this == &r ) {
-
-			return true;
-		}
-
-		for ( auto i = m_parents.begin(); i != m_parents.end(); ++i ) {
-
-			if ( (*i)->derivesFrom( r ) ) {
-
-				return true;
-			}
-		}
-
-		return false;
-	}
-
-private:
-	const char* m_className;
-	const vector<const RTTI*> m_parents;
-};
-
-/**
- * 	VARIADIC TEMPLATE MONSTROSITY
- */
-template<typename Derived, typename... Parents>
-class RTTIInfo : public RTTI {
-public:
-	RTTIInfo( const char* className )
-		: RTTI( className, { &Parents::typeInfo... } ) // build list from expansion of variadic parents
-	{}
-};
+#include "rtti.h"
+#include "type-table.h"
+#include "query-cache.h"
+#include "type-tag.h"
 
-/**
- * 	MACRO HELPER REPRESENT
- */
-#define RTTI_DECLARE() \
-	public: static const RTTI typeInfo; \
-	public: virtual const RTTI& getTypeInfo() const { return typeInfo; }
-
-#define RTTI_DEFINE(ThisClass, Parents...) \
-	const RTTI ThisClass::typeInfo = RTTIInfo<ThisClass, ##Parents>(#ThisClass);
+using namespace std;
 
 /**
  * 	TESTS FOR REALZ
@@ -99,6 +45,23 @@ RTTI_DEFINE(Teacher,StaffMember);
 RTTI_DEFINE(TeachingLibrarian,Teacher,Librarian);
 RTTI_DEFINE(Sailboat);
 
+// tagged ones carry their type index around with them
+class Vessel : public RTTITaggedAs<Vessel>
+{
+	RTTI_DECLARE();
+public:
+	Vessel() {}
+	virtual ~Vessel() {}
+};
+
+class Dinghy : public RTTITaggedAs<Dinghy, Vessel>
+{
+	RTTI_DECLARE();
+};
+
+RTTI_DEFINE(Vessel);
+RTTI_DEFINE(Dinghy,Vessel);
+
 void classfulRTTITest()
 {
 	// these will leak memory but I don't care for this test
@@ -132,16 +95,108 @@ void classfulRTTITest()
 	// multiple inheritance 1 level invalid upcast
 	assert(teachingLibrarian->getTypeInfo().derivesFrom(sailboat->getTypeInfo()) == false);
 
+	// diamond through both sides
+	assert(teachingLibrarian->getTypeInfo().derivesFrom(Teacher::typeInfo));
+	assert(teachingLibrarian->getTypeInfo().derivesFrom(Librarian::typeInfo));
+
+	// no upside-down casts
+	assert(staff->getTypeInfo().derivesFrom(teachingLibrarian->getTypeInfo()) == false);
+
+	// compile-time checks straight from the RTTI_DEFINE parent packs
+	static_assert(rtti_derives_v<TeachingLibrarian, StaffMember>, "diamond upcast");
+	static_assert(rtti_derives_v<TeachingLibrarian, Librarian>, "1 level upcast");
+	static_assert(rtti_derives_v<const Teacher, StaffMember>, "cv doesn't matter");
+	static_assert(!rtti_derives_v<Librarian, Teacher>, "no cross-casts");
+	static_assert(!rtti_derives_v<StaffMember, Librarian>, "no downcasts");
+	static_assert(!rtti_derives_v<Sailboat, StaffMember>, "unrelated");
+
+	// statically known upcast folds to true
+	TeachingLibrarian concreteTeachingLibrarian;
+	assert(derivesFrom<StaffMember>(&concreteTeachingLibrarian));
+
+	// statically unknown falls back to the runtime check
+	assert(derivesFrom<Librarian>(teachingLibrarian));
+	assert(derivesFrom<Librarian>(teacher) == false);
+
+	// every type gets its own index
+	assert(StaffMember::typeInfo.getIndex() != TeachingLibrarian::typeInfo.getIndex());
+	assert(Sailboat::typeInfo.getIndex() < RTTIRegistry::typeCount());
+
 	std::cout << "Classful tests successful" << std::endl;
 }
 
+void rttiCastTest()
+{
+	TeachingLibrarian teachingLibrarianObject;
+	Librarian librarianObject;
+	StaffMember* staff = &teachingLibrarianObject;
+	StaffMember* librarian = &librarianObject;
+
+	// upcast through a virtual base
+	assert(rtti_cast<StaffMember*>(&teachingLibrarianObject) == staff);
+
+	// downcast out of a virtual base, where static_cast gives up
+	assert(rtti_cast<TeachingLibrarian*>(staff) == &teachingLibrarianObject);
+	assert(rtti_cast<Librarian*>(staff) == static_cast<Librarian*>(&teachingLibrarianObject));
+
+	// cross-cast from one side of the diamond to the other
+	Librarian* side = &teachingLibrarianObject;
+	assert(rtti_cast<Teacher*>(side) == static_cast<Teacher*>(&teachingLibrarianObject));
+
+	// invalid downcast
+	assert(rtti_cast<Teacher*>(librarian) == nullptr);
+	assert(rtti_cast<TeachingLibrarian*>(librarian) == nullptr);
+
+	// agrees with the real thing
+	assert(rtti_cast<Librarian*>(librarian) == dynamic_cast<Librarian*>(librarian));
+	assert(rtti_cast<Teacher*>(staff) == dynamic_cast<Teacher*>(staff));
+
+	// constness sticks around
+	const StaffMember* constStaff = staff;
+	assert(rtti_cast<const Teacher*>(constStaff) == static_cast<const Teacher*>(&teachingLibrarianObject));
+
+	// and null stays null
+	assert(rtti_cast<Librarian*>(static_cast<StaffMember*>(nullptr)) == nullptr);
+
+	std::cout << "Cast tests successful" << std::endl;
+}
+
+// listed child-first on purpose, order doesn't matter
+typedef RTTITypeTable<TeachingLibrarian, Teacher, Librarian, StaffMember, Sailboat> StaffTypes;
+
+void typeTableTest()
+{
+	// all of it at compile time
+	static_assert(StaffTypes::size == 5, "five types");
+	static_assert(StaffTypes::indexOf<Sailboat>() == 4, "listed order");
+	static_assert(StaffTypes::indexOf<int>() == StaffTypes::NOT_IN_TABLE, "not listed");
+	static_assert(StaffTypes::descriptors[StaffTypes::indexOf<TeachingLibrarian>()].parentCount == 2, "two parents");
+	static_assert(StaffTypes::derivesFrom<TeachingLibrarian, StaffMember>(), "diamond upcast");
+	static_assert(StaffTypes::derivesFrom<Librarian, StaffMember>(), "1 level upcast");
+	static_assert(!StaffTypes::derivesFrom<Librarian, Teacher>(), "no cross-casts");
+	static_assert(!StaffTypes::derivesFrom<StaffMember, Sailboat>(), "unrelated");
+
+	// and back from a runtime descriptor
+	Teacher teacher;
+	const StaffMember* staff = &teacher;
+	const unsigned index = StaffTypes::indexOf(staff->getTypeInfo());
+	assert(index == StaffTypes::indexOf<Teacher>());
+	assert(StaffTypes::descriptors[index].type == &Teacher::typeInfo);
+	assert(StaffTypes::derivesFrom(index, StaffTypes::indexOf<StaffMember>()));
+	assert(StaffTypes::indexOf(DynamicRTTI("Unlisted", {})) == StaffTypes::NOT_IN_TABLE);
+	static_assert(!StaffTypes::derivesFrom(StaffTypes::NOT_IN_TABLE, 0), "not a table index");
+	static_assert(!StaffTypes::derivesFrom(0, StaffTypes::size), "past the end");
+
+	std::cout << "Type table tests successful" << std::endl;
+}
+
 void classlessRTTITest()
 {
-	const RTTI vehicleType("Vehicle", {});
-	const RTTI landVehicleType("LandVehicle", { &vehicleType });
-	const RTTI waterVehicleType("WaterVehicle", { &vehicleType });
-	const RTTI amphibiousVehicleType("AmphibiousVehicle", { &landVehicleType, &waterVehicleType });
-	const RTTI fruitType("Fruit", {});
+	const DynamicRTTI vehicleType("Vehicle", {});
+	const DynamicRTTI landVehicleType("LandVehicle", { &vehicleType });
+	const DynamicRTTI waterVehicleType("WaterVehicle", { &vehicleType });
+	const DynamicRTTI amphibiousVehicleType("AmphibiousVehicle", { &landVehicleType, &waterVehicleType });
+	const DynamicRTTI fruitType("Fruit", {});
 
 	// class name
 	assert(std::string(vehicleType.getClassName()) == "Vehicle");
@@ -164,9 +219,141 @@ void classlessRTTITest()
 	// multiple inheritance 1 level invalid upcast
 	assert(amphibiousVehicleType.derivesFrom(fruitType) == false);
 
+	// cached answers are the same answers, asked twice
+	RTTIQueryCache cache(4);
+	for (int pass = 0; pass < 2; ++pass) {
+		assert(cache.derivesFrom(amphibiousVehicleType, vehicleType));
+		assert(cache.derivesFrom(landVehicleType, waterVehicleType) == false);
+		assert(cache.derivesFrom(amphibiousVehicleType, fruitType) == false);
+	}
+
+	// registering a new type clears the cache, and the new type works right away
+	const DynamicRTTI appleType("Apple", { &fruitType });
+	assert(cache.derivesFrom(appleType, fruitType));
+	assert(cache.derivesFrom(appleType, vehicleType) == false);
+	assert(cache.derivesFrom(amphibiousVehicleType, vehicleType));
+
+	// more pairs than slots still gives the right answers
+	const RTTI* types[] = { &vehicleType, &landVehicleType, &waterVehicleType, &amphibiousVehicleType, &fruitType, &appleType };
+	for (int invalidations = 0; invalidations < 300; ++invalidations) {
+		for (const RTTI* a : types)
+			for (const RTTI* b : types)
+				assert(cache.derivesFrom(*a, *b) == a->derivesFrom(*b));
+		cache.invalidate();
+	}
+
 	std::cout << "Classless tests successful" << std::endl;
 }
 
+/**
+ * 	REGISTRY TESTS
+ */
+void registryTest()
+{
+	// statically defined types are in there from the start
+	assert(RTTIRegistry::find("TeachingLibrarian") == &TeachingLibrarian::typeInfo);
+	assert(RTTIRegistry::find(StaffMember::typeInfo.getIndex()) == &StaffMember::typeInfo);
+	assert(RTTIRegistry::find("Nobody") == nullptr);
+
+	// type tags by name hash, worked out at compile time
+	static_assert(rtti_name_hash("Teacher") == 0x1a836c35u, "FNV-1a changed");
+	constexpr std::uint32_t teacherTag = rtti_name_hash("Teacher");
+	assert(Teacher::typeInfo.getNameHash() == teacherTag);
+	assert(RTTIRegistry::findByHash(teacherTag) == &Teacher::typeInfo);
+	assert(RTTIRegistry::findByHash(rtti_name_hash("Nobody")) == nullptr);
+
+	unsigned seen = 0;
+	RTTIRegistry::forEach([&seen](const RTTI& type) { assert(RTTIRegistry::find(type.getIndex()) == &type); ++seen; });
+	assert(seen >= 5);
+
+	// late registration, like a plugin would
+	unsigned pluginIndex;
+	{
+		const DynamicRTTI pluginType("Plugin", { &StaffMember::typeInfo });
+		pluginIndex = pluginType.getIndex();
+		assert(RTTIRegistry::find("Plugin") == &pluginType);
+		assert(RTTIRegistry::find(pluginIndex) == &pluginType);
+		assert(RTTIRegistry::findByHash(rtti_name_hash("Plugin")) == &pluginType);
+	}
+
+	// and gone again once it is
+	assert(RTTIRegistry::find("Plugin") == nullptr);
+	assert(RTTIRegistry::find(pluginIndex) == nullptr);
+
+	// readers looking things up while a writer registers enough types to grow the table a few times
+	std::vector<std::string> names;
+	for (int i = 0; i < 500; ++i)
+		names.push_back("Loaded" + std::to_string(i));
+
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; ++r) {
+		readers.emplace_back([&done] {
+			while (!done.load()) {
+				assert(RTTIRegistry::find("Librarian") == &Librarian::typeInfo);
+				assert(RTTIRegistry::find(Teacher::typeInfo.getIndex()) == &Teacher::typeInfo);
+			}
+		});
+	}
+
+	std::vector<std::unique_ptr<DynamicRTTI>> loaded;
+	for (const std::string& name : names)
+		loaded.emplace_back(new DynamicRTTI(name.c_str(), { &Teacher::typeInfo }));
+
+	done.store(true);
+	for (std::thread& reader : readers)
+		reader.join();
+
+	for (size_t i = 0; i < loaded.size(); ++i)
+		assert(RTTIRegistry::find(names[i].c_str()) == loaded[i].get());
+	loaded.clear();
+	assert(RTTIRegistry::find("Loaded42") == nullptr);
+
+	std::cout << "Registry tests successful" << std::endl;
+}
+
+/**
+ * 	TYPE TAG TESTS
+ */
+void typeTagTest()
+{
+	Vessel vessel;
+	Dinghy dinghy;
+	const Vessel* dinghyAsVessel = &dinghy;
+
+	// the most derived constructor wins
+	assert(vessel.getTypeTag() == Vessel::typeInfo.getIndex());
+	assert(dinghyAsVessel->getTypeTag() == Dinghy::typeInfo.getIndex());
+
+	// a copy is tagged as what it is, not what it was copied from
+	Vessel sliced(dinghy);
+	assert(sliced.getTypeTag() == Vessel::typeInfo.getIndex());
+	sliced = dinghy;
+	assert(sliced.getTypeTag() == Vessel::typeInfo.getIndex());
+
+	// subtypes are in, supertypes and strangers are out
+	const RTTITagSet vessels(Vessel::typeInfo);
+	const RTTITagSet dinghies(Dinghy::typeInfo);
+	assert(vessels.contains(vessel.getTypeTag()));
+	assert(vessels.contains(dinghy.getTypeTag()));
+	assert(dinghies.contains(dinghy.getTypeTag()));
+	assert(dinghies.contains(vessel.getTypeTag()) == false);
+	assert(vessels.contains(Sailboat::typeInfo.getIndex()) == false);
+	assert(vessels.contains(RTTITagged::NO_TAG) == false);
+	assert(rtti_tag_is(dinghyAsVessel, dinghies));
+
+	// types that turn up later need a refresh
+	RTTITagSet staff(StaffMember::typeInfo);
+	{
+		const DynamicRTTI substituteType("Substitute", { &Teacher::typeInfo });
+		assert(staff.contains(substituteType.getIndex()) == false);
+		staff.refresh();
+		assert(staff.contains(substituteType.getIndex()));
+	}
+
+	std::cout << "Type tag tests successful" << std::endl;
+}
+
 /**
  * 	MAIN DAWG
  */
@@ -174,6 +361,10 @@ int main()
 {
 	classlessRTTITest();
 	classfulRTTITest();
+	rttiCastTest();
+	typeTableTest();
+	registryTest();
+	typeTagTest();
 
 	std::cout << "All tests successful" << std::endl;
 }
@@ -30,6 +30,13 @@
 #include <iostream>
 #include <vector>
 #include <string>
+
+#include "../rtti/rtti.h"
+#include "traversal.h"
+#include "output-sink.h"
+#include "shape-pool.h"
+#include "multi-dispatch.h"
+
 using namespace std;
 
 #define PI 3.1415
@@ -40,7 +47,10 @@ class Visitor;
 // Notice that, much like yours truly,
 // this class doesn't actually do anything.
 // It's just there so the Shape can accept it.
+// It does carry around the home-brewed RTTI, though,
+// so the side-casts below don't need dynamic_cast.
 class AbstractVisitor {
+	RTTI_DECLARE();
 public:
 	// The class needs at least one virtual method.
 	// (it's a C++ thing.)
@@ -48,7 +58,9 @@ public:
 };
 
 // Once again, the base Shape class. 
+// The Shapes get the RTTI too, for the pairs at the end of main.
 class Shape {
+	RTTI_DECLARE();
 	public:
 		virtual ~Shape() {}
 		float x, y;
@@ -63,6 +75,10 @@ class Shape {
 		// this is a practical way to avoid writing the accept.
 		// (Also, ouch, man, that's cold)
 		virtual void accept( AbstractVisitor* av ) { }
+
+		// The batched accept, for Shapes grouped by type.
+		// The side-cast only has to happen once per batch.
+		virtual void acceptBatch( AbstractVisitor* av, Span<Shape* const> batch ) { }
 };
 
 class Rectangle;
@@ -77,12 +93,20 @@ class Triangle;
 // visitors needs to written for every visitable
 // object.
 class RectangleVisitor {
+	RTTI_DECLARE();
 public:
 	virtual void visit( Rectangle* rectangle ) = 0;
+
+	// Visits a whole batch of Rectangles.
+	// Override it if you can do better than one at a time.
+	virtual void visit( Batch<Rectangle, Shape> rectangles ) {
+		for ( Rectangle* rectangle : rectangles ) visit( rectangle );
+	}
 };
 
 // The derived Rectangle class.
 class Rectangle : public Shape {
+	RTTI_DECLARE();
 public:
 	float w, h;
 	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
@@ -92,12 +116,16 @@ public:
 	// However, it's a little more advanced than the regualr Visitor.
 	void accept( AbstractVisitor* av ) {
 
+		INSTRUMENT_SCOPE( ACCEPT );
+
 		// The Rectangle must first check to see if
 		// the Visitor is, in fact, a RectangleVisitor.
-		// This is done with a dynamic_cast here,
-		// but it could conceivably be done with a
-		// home-brewed type system for better performance.
-		RectangleVisitor* rv = dynamic_cast<RectangleVisitor*>( av );
+		// This could be done with a dynamic_cast,
+		// but here it's done with the home-brewed
+		// type system in rtti/ for better performance.
+		// (A bit test and two loads instead of a
+		// walk through the compiler's type_info.)
+		RectangleVisitor* rv = rtti_cast<RectangleVisitor*>( av );
 
 		// If the visitor is a RectangleVisitor,
 		// visit away!
@@ -105,27 +133,51 @@ public:
 			rv->visit( this );
 		}
 	}
+
+	void acceptBatch( AbstractVisitor* av, Span<Shape* const> batch ) {
+
+		RectangleVisitor* rv = rtti_cast<RectangleVisitor*>( av );
+		if ( rv ) {
+			rv->visit( Batch<Rectangle, Shape>( batch ) );
+		}
+	}
 };
 
 // Ditto the CircleVisitor.
 class CircleVisitor {
+	RTTI_DECLARE();
 public:
 	virtual void visit( Circle* circle ) = 0;
+
+	virtual void visit( Batch<Circle, Shape> circles ) {
+		for ( Circle* circle : circles ) visit( circle );
+	}
 };
 
 // And the Circle.
 class Circle : public Shape {
+	RTTI_DECLARE();
 public:
 	float r;
 	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
 
 	void accept( AbstractVisitor* av ) {
 
-		CircleVisitor* cv = dynamic_cast<CircleVisitor*>( av );
+		INSTRUMENT_SCOPE( ACCEPT );
+
+		CircleVisitor* cv = rtti_cast<CircleVisitor*>( av );
 		if ( cv ) {
 			cv->visit( this );
 		}
 	}
+
+	void acceptBatch( AbstractVisitor* av, Span<Shape* const> batch ) {
+
+		CircleVisitor* cv = rtti_cast<CircleVisitor*>( av );
+		if ( cv ) {
+			cv->visit( Batch<Circle, Shape>( batch ) );
+		}
+	}
 };
 
 // And hey, even the TriangleVisitor.
@@ -135,23 +187,39 @@ public:
 // However, for the Triangle to be visited,
 // we need a TriangleVisitor.
 class TriangleVisitor {
+	RTTI_DECLARE();
 public:
 	virtual void visit( Triangle* triangle ) = 0;
+
+	virtual void visit( Batch<Triangle, Shape> triangles ) {
+		for ( Triangle* triangle : triangles ) visit( triangle );
+	}
 };
 
 // Errybody's favourite shape!
 class Triangle : public Shape {
+	RTTI_DECLARE();
 public:
 	float b, h;
 	Triangle( float x, float y, float b, float h ) : Shape(x,y), b(b), h(h) {}
 
 	void accept( AbstractVisitor* av ) {
 
-		TriangleVisitor* tv = dynamic_cast<TriangleVisitor*>( av );
+		INSTRUMENT_SCOPE( ACCEPT );
+
+		TriangleVisitor* tv = rtti_cast<TriangleVisitor*>( av );
 		if ( tv ) {
 			tv->visit( this );
 		}
 	}
+
+	void acceptBatch( AbstractVisitor* av, Span<Shape* const> batch ) {
+
+		TriangleVisitor* tv = rtti_cast<TriangleVisitor*>( av );
+		if ( tv ) {
+			tv->visit( Batch<Triangle, Shape>( batch ) );
+		}
+	}
 };
 
 // An example of a concrete visitor.
@@ -166,20 +234,26 @@ class AreaCalculator :
 	public AbstractVisitor,
 	public RectangleVisitor,
 	public CircleVisitor {
+	RTTI_DECLARE();
 public:
+	AreaCalculator( OutputSink& out ) : out(out) {}
+
 	void visit( Rectangle* rectangle ) {
 
 		float area;
 		area = rectangle->w * rectangle->h;
-		cout << "rectangle area is: " << area << endl;
+		out << "rectangle area is: " << area << '\n';
 	}
 
 	void visit( Circle* circle ) {
 
 		float area;
 		area = PI * circle->r * circle->r;
-		cout << "circle area is: " << area << endl;
+		out << "circle area is: " << area << '\n';
 	}
+
+private:
+	OutputSink& out;
 };
 
 // Remember, the concrete Visitor
@@ -193,18 +267,24 @@ class Namer :
 	public RectangleVisitor,
 	public CircleVisitor,
 	public TriangleVisitor {
+	RTTI_DECLARE();
 public:
+	Namer( OutputSink& out ) : out(out) {}
+
 	void visit( Rectangle* rectangle ) {
-		cout << "name: " << "rectangle" << endl;
+		out << "name: " << "rectangle" << '\n';
 	}
 
 	void visit( Circle* circle ) {
-		cout << "name: " << "circle" << endl;
+		out << "name: " << "circle" << '\n';
 	}
 
 	void visit( Triangle* triangle ) {
-		cout << "name: " << "triangle" << endl;
+		out << "name: " << "triangle" << '\n';
 	}
+
+private:
+	OutputSink& out;
 };
 
 // For emphasis, it's worth pointing out
@@ -214,49 +294,114 @@ public:
 class RectangleCounter :
 	public AbstractVisitor,
 	public RectangleVisitor {
+	RTTI_DECLARE();
 public:
 	float count;
 	RectangleCounter() : count(0) {}
 
+	void reset() { count = 0; }
+
 	void visit(Rectangle* rectangle) { ++count; }
+
+	using RectangleVisitor::visit;
+	void visit(Batch<Rectangle, Shape> rectangles) { count += rectangles.size(); }
 };
 
 
+// Every visitor has to tell the RTTI who its parents are
+// so rtti_cast can find the specialized visitors inside it.
+RTTI_DEFINE(AbstractVisitor);
+RTTI_DEFINE(RectangleVisitor);
+RTTI_DEFINE(CircleVisitor);
+RTTI_DEFINE(TriangleVisitor);
+RTTI_DEFINE(AreaCalculator, AbstractVisitor, RectangleVisitor, CircleVisitor);
+RTTI_DEFINE(Namer, AbstractVisitor, RectangleVisitor, CircleVisitor, TriangleVisitor);
+RTTI_DEFINE(RectangleCounter, AbstractVisitor, RectangleVisitor);
+
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Circle, Shape);
+RTTI_DEFINE(Triangle, Shape);
 
 typedef vector<Shape*> ShapeList;
 
+// When two shapes bump into each other. There's one for
+// rectangles and circles, and one for everything else.
+void rectangleBumpsCircle( Rectangle& a, Circle& b ) {
+	cout << "a rectangle at " << a.x << "," << a.y << " bumps a circle at " << b.x << "," << b.y << endl;
+}
+
+void shapeBumpsShape( Shape& a, Shape& b ) {
+	cout << "a " << a.getTypeInfo().getClassName() << " bumps a " << b.getTypeInfo().getClassName() << endl;
+}
+
 int main() {
 
+	ShapePool<Rectangle, Circle, Triangle> shapes;
 	ShapeList list;
-	list.push_back( new Rectangle(0,0,10,20) );
-	list.push_back( new Rectangle(10,10, 5,3) );
-	list.push_back( new Circle( 5,5, 15) );
-	list.push_back( new Triangle(2,2, 4, 3.14) );
+	list.push_back( shapes.create<Rectangle>(0,0,10,20) );
+	list.push_back( shapes.create<Rectangle>(10,10, 5,3) );
+	list.push_back( shapes.create<Circle>( 5,5, 15) );
+	list.push_back( shapes.create<Triangle>(2,2, 4, 3.14) );
+
+	// visitors on the stack, reused, output flushed once per traversal
+	OutputSink out( cout );
+	AreaCalculator ac( out );
+	Namer n( out );
+	RectangleCounter rc;
 
 	// areas
-	AreaCalculator *ac = new AreaCalculator();
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( ac );
+		list[i]->accept( &ac );
 	}
-	delete ac;
+	out.flush();
 
 	// name
-	Namer *n = new Namer();
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( n );
+		list[i]->accept( &n );
 	}
-	delete n;
+	out.flush();
 
 	// counting
-	RectangleCounter *rc = new RectangleCounter();
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( rc );
+		list[i]->accept( &rc );
+	}
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	// batched, one side-cast per type instead of per shape
+	TypeBatches<Shape> batches;
+	batches.update( list );
+
+	rc.reset();
+	batches.accept( &rc );
+	cout << "there are " << rc.count << " batched rectangles" << endl;
+
+	// pairs, one table lookup on both types (the acyclic visitor is all
+	// about one type at a time). The Triangle and the two Rectangles
+	// don't have a handler of their own, so they get the nearest one up
+	// the hierarchy, the Shape one. See collision-matrix.cpp.
+	MultiDispatcher<Shape> bump;
+	bump.add( &rectangleBumpsCircle );
+	bump.add( &shapeBumpsShape );
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		for ( size_t j = i + 1; j < list.size(); ++j ) {
+			bump.dispatch( *list[i], *list[j] );
+		}
+	}
+
+	// build with -DENABLE_INSTRUMENTATION to see how often the hot bits ran
+	if ( Instrumentation::enabled ) {
+
+		Instrumentation::Snapshot counts = Instrumentation::snapshot();
+		for ( int p = 0; p < Instrumentation::PROBE_COUNT; ++p ) {
+			Instrumentation::Probe probe = Instrumentation::Probe( p );
+			cout << Instrumentation::probeName( probe ) << ": " << counts.calls[p] << " calls, "
+				<< counts.cycles[p] << " cycles" << endl;
+		}
 	}
-	cout << "there are " << rc->count << " rectangles" << endl;
-	delete rc;
 
-	for ( int i = 0; i < list.size(); ++i )
-		delete list[i];
+	list.clear();
+	shapes.clear();
 
 	return 0;
 }
@@ -0,0 +1,131 @@
+//
+//			The Collision Matrix
+//
+//	A Visitor picks what to do based on the type of one thing.
+//	Collisions need two: a Circle hitting a Rectangle isn't
+//	a Circle hitting a Circle. That's "double dispatch" for real,
+//	and doing it with visitors means a visitor per shape that
+//	visits every other shape. Yuck.
+//
+//	So: a table. Rows are the first shape's type, columns are
+//	the second's, and every cell says what to do.
+//	Looking it up is one index with both RTTI indices.
+//
+//	You don't have to fill in every cell. A Square is a Rectangle,
+//	so when nobody wrote a Square-vs-Circle handler, the
+//	Rectangle-vs-Circle one steps in. The table works that
+//	out the first time it sees the pair and remembers it.
+//
+//	The machinery lives in multi-dispatch.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "multi-dispatch.h"
+
+using namespace std;
+
+class Shape {
+	RTTI_DECLARE();
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+};
+
+class Rectangle : public Shape {
+	RTTI_DECLARE();
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+};
+
+// No handlers of its own. It borrows the Rectangle's.
+class Square : public Rectangle {
+	RTTI_DECLARE();
+public:
+	Square( float x, float y, float side ) : Rectangle(x,y,side,side) {}
+};
+
+class Circle : public Shape {
+	RTTI_DECLARE();
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+};
+
+// Nobody knows how to collide triangles. Again.
+class Triangle : public Shape {
+	RTTI_DECLARE();
+public:
+	float b, h;
+	Triangle( float x, float y, float b, float h ) : Shape(x,y), b(b), h(h) {}
+};
+
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Square, Rectangle);
+RTTI_DEFINE(Circle, Shape);
+RTTI_DEFINE(Triangle, Shape);
+
+// The handlers. Plain functions that take the exact types they handle.
+void rectangleRectangle( Rectangle& a, Rectangle& b ) {
+
+	bool hit = a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+	cout << a.getTypeInfo().getClassName() << " vs " << b.getTypeInfo().getClassName()
+		<< ( hit ? ": hit" : ": miss" ) << endl;
+}
+
+void rectangleCircle( Rectangle& a, Circle& b ) {
+
+	float nearestX = b.x < a.x ? a.x : ( b.x > a.x + a.w ? a.x + a.w : b.x );
+	float nearestY = b.y < a.y ? a.y : ( b.y > a.y + a.h ? a.y + a.h : b.y );
+	float dx = b.x - nearestX, dy = b.y - nearestY;
+	bool hit = dx * dx + dy * dy < b.r * b.r;
+	cout << a.getTypeInfo().getClassName() << " vs circle" << ( hit ? ": hit" : ": miss" ) << endl;
+}
+
+void circleCircle( Circle& a, Circle& b ) {
+
+	float dx = a.x - b.x, dy = a.y - b.y, r = a.r + b.r;
+	cout << "circle vs circle" << ( dx * dx + dy * dy < r * r ? ": hit" : ": miss" ) << endl;
+}
+
+typedef vector<Shape*> ShapeList;
+
+int main() {
+
+	MultiDispatcher<Shape> collide;
+	collide.add( &rectangleRectangle );
+	collide.add( &rectangleCircle ); // Circle vs Rectangle comes free
+	collide.add( &circleCircle );
+
+	ShapeList list;
+	list.push_back( new Rectangle(0,0,10,20) );
+	list.push_back( new Square(5,5, 3) );
+	list.push_back( new Circle( 12,5, 3) );
+	list.push_back( new Triangle(2,2, 4, 3.14) );
+
+	// every pair, once
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		for ( size_t j = i + 1; j < list.size(); ++j ) {
+
+			if ( !collide.dispatch( *list[i], *list[j] ) ) {
+				cout << list[i]->getTypeInfo().getClassName() << " vs "
+					<< list[j]->getTypeInfo().getClassName() << ": no idea" << endl;
+			}
+		}
+	}
+
+	// the other way around finds the same handler
+	collide.dispatch( *list[2], *list[0] );
+
+	// and the table's only as big as the shapes that turned up
+	cout << "table: " << collide.rowCount() << " x " << collide.columnCount() << endl;
+
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+
+	return 0;
+}
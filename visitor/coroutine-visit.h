@@ -0,0 +1,374 @@
+#ifndef COROUTINE_VISIT_H
+#define COROUTINE_VISIT_H
+
+// This one's C++20: it needs coroutines. Build with -std=c++20.
+#if __cplusplus < 202002L
+#error "coroutine-visit.h needs C++20 (-std=c++20)"
+#endif
+
+#include <coroutine>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <exception>
+#include <utility>
+#include <cstddef>
+
+// How much of a traversal a frame gets: so many elements or so much time,
+// whichever runs out first. Zero means no limit on that one.
+class FrameBudget {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	FrameBudget( std::size_t elements = 0, Clock::duration time = Clock::duration::zero() )
+		: m_elements( elements ), m_time( time ) {}
+
+	bool spent( std::size_t elementsDone, Clock::time_point frameStart ) const {
+
+		if ( m_elements && elementsDone >= m_elements ) {
+			return true;
+		}
+		return m_time != Clock::duration::zero() && Clock::now() - frameStart >= m_time;
+	}
+
+private:
+	std::size_t m_elements;
+	Clock::duration m_time;
+};
+
+// A thread that runs whatever it's handed, in order, off the main loop.
+// For the slow, blocking bits of a visit, like writing to a file.
+class AsyncExecutor {
+public:
+	AsyncExecutor() : m_stop( false ), m_thread( [this] { workerLoop(); } ) {}
+
+	// finishes everything already submitted first
+	~AsyncExecutor() {
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+	AsyncExecutor( const AsyncExecutor& ) = delete;
+	AsyncExecutor& operator=( const AsyncExecutor& ) = delete;
+
+	void submit( std::function<void()> job ) {
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_jobs.push_back( std::move( job ) );
+		}
+		m_wake.notify_one();
+	}
+
+private:
+	void workerLoop() {
+
+		for ( ;; ) {
+
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock( m_mutex );
+				m_wake.wait( lock, [this] { return m_stop || !m_jobs.empty(); } );
+				if ( m_jobs.empty() ) {
+					return;
+				}
+				job = std::move( m_jobs.front() );
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()>> m_jobs;
+	bool m_stop;
+	std::thread m_thread;
+};
+
+// A traversal spread across frames.
+//
+// Write it as a coroutine returning VisitTask: a plain loop over the list,
+// with co_await checkpoint() after each element and an offload (below)
+// around anything that blocks. Then call resume() once a frame until it
+// returns false. Each resume() runs until the frame's budget is spent and
+// parks the coroutine; locals, the loop index and the visitor (held by
+// reference) are all exactly where they were next frame.
+//
+// Work handed to offload() runs on the executor. The coroutine waits for it
+// without holding up the frame: resume() says "not yet" and returns straight
+// away until it's done, and the coroutine always carries on on the thread
+// calling resume(), never on the executor's. Work handed to queued() isn't
+// waited for at all, just finished before the task counts as done.
+//
+// The list and visitor have to outlive the task. Exceptions from the
+// coroutine or from offloaded work come out of resume().
+class VisitTask {
+public:
+	struct OffloadState {
+		std::atomic<bool> done;
+		std::exception_ptr error;
+		OffloadState() : done( false ) {}
+	};
+
+	// everything queued() and not finished yet, and the first thing that threw
+	struct QueueState {
+		std::atomic<std::size_t> outstanding;
+		std::mutex mutex;
+		std::exception_ptr error;
+		QueueState() : outstanding( 0 ) {}
+	};
+
+	struct promise_type {
+		FrameBudget budget;
+		FrameBudget::Clock::time_point frameStart;
+		std::size_t elementsThisFrame;
+		std::shared_ptr<OffloadState> waitingOn;
+		std::shared_ptr<QueueState> queued;
+		std::exception_ptr error;
+
+		promise_type() : elementsThisFrame( 0 ), queued( std::make_shared<QueueState>() ) {}
+
+		VisitTask get_return_object() { return VisitTask( std::coroutine_handle<promise_type>::from_promise( *this ) ); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	typedef std::coroutine_handle<promise_type> Handle;
+
+	VisitTask() : m_handle( nullptr ) {}
+	explicit VisitTask( Handle handle ) : m_handle( handle ) {}
+
+	VisitTask( VisitTask&& other ) noexcept : m_handle( other.m_handle ) { other.m_handle = nullptr; }
+	VisitTask& operator=( VisitTask&& other ) noexcept {
+
+		if ( this != &other ) {
+			destroy();
+			m_handle = other.m_handle;
+			other.m_handle = nullptr;
+		}
+		return *this;
+	}
+
+	VisitTask( const VisitTask& ) = delete;
+	VisitTask& operator=( const VisitTask& ) = delete;
+
+	~VisitTask() {
+
+		destroy();
+	}
+
+	void setBudget( const FrameBudget& budget ) {
+
+		m_handle.promise().budget = budget;
+	}
+
+	// One frame's worth. True while there's more to do, which includes
+	// queued work that hasn't finished yet.
+	bool resume() {
+
+		if ( !m_handle ) {
+			return false;
+		}
+
+		promise_type& promise = m_handle.promise();
+		rethrowQueued( promise );
+		if ( m_handle.done() ) {
+			return queuedOutstanding();
+		}
+
+		if ( promise.waitingOn && !promise.waitingOn->done.load( std::memory_order_acquire ) ) {
+			return true;
+		}
+		promise.waitingOn = nullptr;
+
+		promise.frameStart = FrameBudget::Clock::now();
+		promise.elementsThisFrame = 0;
+		m_handle.resume();
+
+		if ( promise.error ) {
+			std::rethrow_exception( std::exchange( promise.error, nullptr ) );
+		}
+		rethrowQueued( promise );
+		return !m_handle.done() || queuedOutstanding();
+	}
+
+	bool done() const {
+
+		return !m_handle || ( m_handle.done() && !queuedOutstanding() );
+	}
+
+	// still waiting on something offloaded, or on queued work
+	bool waiting() const {
+
+		if ( done() ) {
+			return false;
+		}
+
+		const promise_type& promise = m_handle.promise();
+		return m_handle.done() || ( promise.waitingOn && !promise.waitingOn->done.load( std::memory_order_acquire ) );
+	}
+
+private:
+	bool queuedOutstanding() const {
+
+		return m_handle.promise().queued->outstanding.load( std::memory_order_acquire ) != 0;
+	}
+
+	static void rethrowQueued( promise_type& promise ) {
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock( promise.queued->mutex );
+			error = std::exchange( promise.queued->error, nullptr );
+		}
+		if ( error ) {
+			std::rethrow_exception( error );
+		}
+	}
+
+	void destroy() {
+
+		if ( m_handle ) {
+			m_handle.destroy();
+			m_handle = nullptr;
+		}
+	}
+
+	Handle m_handle;
+};
+
+// co_await after each element: counts it, and parks until next frame if the budget's spent.
+struct checkpoint {
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend( VisitTask::Handle handle ) const {
+
+		VisitTask::promise_type& promise = handle.promise();
+		++promise.elementsThisFrame;
+		return promise.budget.spent( promise.elementsThisFrame, promise.frameStart );
+	}
+
+	void await_resume() const noexcept {}
+};
+
+// co_await offload( executor, job ): job runs on the executor,
+// and the coroutine picks up on a later frame once it's finished.
+// If it's already finished by the time the coroutine would park, it
+// just carries on; otherwise waiting ends the current frame.
+//
+// GCC 12 can destroy a lambda temporary twice when it's built inside the
+// co_await expression, so name it first:
+//	offload write( io, [line] { ... } );
+//	co_await write;
+class offload {
+public:
+	offload( AsyncExecutor& executor, std::function<void()> job ) : m_executor( executor ), m_job( std::move( job ) ) {}
+
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend( VisitTask::Handle handle ) {
+
+		m_state = std::make_shared<VisitTask::OffloadState>();
+
+		std::shared_ptr<VisitTask::OffloadState> state = m_state;
+		std::function<void()> job = std::move( m_job );
+		m_executor.submit( [state, job] {
+
+			try {
+				job();
+			}
+			catch ( ... ) {
+				state->error = std::current_exception();
+			}
+			state->done.store( true, std::memory_order_release );
+		} );
+
+		if ( m_state->done.load( std::memory_order_acquire ) ) {
+			return false;
+		}
+		handle.promise().waitingOn = m_state;
+		return true;
+	}
+
+	void await_resume() {
+
+		if ( m_state->error ) {
+			std::rethrow_exception( m_state->error );
+		}
+	}
+
+private:
+	AsyncExecutor& m_executor;
+	std::function<void()> m_job;
+	std::shared_ptr<VisitTask::OffloadState> m_state;
+};
+
+// co_await queued( executor, job ): hands job to the executor and carries
+// straight on, no waiting and no end of frame, so the frame's budget is
+// the only thing deciding how much gets done. The executor runs jobs in
+// the order they were handed over, so a run of writes lands in order.
+//
+// The task isn't done until they've all run: once the coroutine's
+// finished, resume() keeps saying "not yet" until the last one has, and
+// the first exception any of them throws comes out of resume().
+// It's the same GCC 12 caveat as offload: name it before co_await.
+class queued {
+public:
+	queued( AsyncExecutor& executor, std::function<void()> job ) : m_executor( executor ), m_job( std::move( job ) ) {}
+
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend( VisitTask::Handle handle ) {
+
+		std::shared_ptr<VisitTask::QueueState> state = handle.promise().queued;
+		state->outstanding.fetch_add( 1, std::memory_order_relaxed );
+
+		std::function<void()> job = std::move( m_job );
+		m_executor.submit( [state, job] {
+
+			try {
+				job();
+			}
+			catch ( ... ) {
+				std::lock_guard<std::mutex> lock( state->mutex );
+				if ( !state->error ) {
+					state->error = std::current_exception();
+				}
+			}
+			state->outstanding.fetch_sub( 1, std::memory_order_release );
+		} );
+		return false;
+	}
+
+	void await_resume() const noexcept {}
+
+private:
+	AsyncExecutor& m_executor;
+	std::function<void()> m_job;
+};
+
+// The plain case: every element accepts the visitor, within the budget.
+template<typename List, typename VisitorType>
+VisitTask accept_over_frames( const List& list, VisitorType& visitor ) {
+
+	for ( std::size_t i = 0; i < list.size(); ++i ) {
+
+		list[i]->accept( &visitor );
+		co_await checkpoint();
+	}
+}
+
+#endif
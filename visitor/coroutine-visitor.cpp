@@ -0,0 +1,191 @@
+//
+//			The Visitor That Takes Its Time
+//
+//	Some visitors are slow. Maybe they write every shape out to a
+//	file, maybe they do something expensive per shape. Run one over
+//	a big ShapeList and that frame takes forever, and the game
+//	hitches.
+//
+//	The fix is to not do it all at once. The traversal here is a
+//	coroutine: a function that can stop partway through and carry
+//	on later. Each frame, it gets a budget (so many shapes, or so
+//	many microseconds) and when that's spent it stops, right where
+//	it was, loop index, visitor and all. Next frame it picks up again.
+//
+//	And for the really slow bits, like the actual file writing, the
+//	coroutine hands them off to another thread. It can wait for them
+//	without making the frame wait, or, when all it needs is for them
+//	to happen in order, not wait at all.
+//
+//	This one needs C++20, so: g++ -std=c++20 -pthread coroutine-visitor.cpp
+//
+//	The machinery lives in coroutine-visit.h.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cassert>
+
+#include "coroutine-visit.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+	public:
+		virtual ~Visitor() {}
+		virtual void visit( Rectangle* r ) = 0;
+		virtual void visit( Circle* c ) = 0;
+};
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* v ) = 0;
+};
+
+class Rectangle : public Shape {
+	public:
+		float w, h;
+		Rectangle( float x, float y, float w, float h ) : Shape(x, y), w(w), h(h) {}
+		void accept( Visitor* v ) { v->visit( this ); }
+};
+
+class Circle : public Shape {
+	public:
+		float r;
+		Circle( float x, float y, float r ) : Shape(x, y), r(r) {}
+		void accept( Visitor* v ) { v->visit( this ); }
+};
+
+// Keeps a running total, which has to survive between frames.
+class AreaCalculator : public Visitor {
+	public:
+		float total;
+		int visited;
+		AreaCalculator() : total(0), visited(0) {}
+
+		void visit( Rectangle* r ) { total += r->w * r->h; ++visited; }
+		void visit( Circle* c ) { total += PI * c->r * c->r; ++visited; }
+};
+
+// Works out a name; the writing it down happens elsewhere.
+class Namer : public Visitor {
+	public:
+		string name;
+		int visited;
+		Namer() : visited(0) {}
+
+		void visit( Rectangle* r ) { name = "rectangle"; ++visited; }
+		void visit( Circle* c ) { name = "circle"; ++visited; }
+};
+
+typedef vector<Shape*> ShapeList;
+
+// Names every shape into a file. The naming's quick and happens right here;
+// the writing's slow and goes to the executor. The lines only have to go
+// out in order, so they're queued without waiting on each one; the flush
+// at the end is waited for, so the file's all there when the task's done.
+VisitTask nameIntoFile( const ShapeList& list, Namer& namer, ofstream& file, AsyncExecutor& io ) {
+
+	for ( size_t i = 0; i < list.size(); ++i ) {
+
+		list[i]->accept( &namer );
+
+		const string line = "name: " + namer.name + "\n";
+		queued write( io, [&file, line] { file << line; } );
+		co_await write;
+		co_await checkpoint();
+	}
+
+	offload flush( io, [&file] { file.flush(); } );
+	co_await flush;
+}
+
+int main() {
+
+	ShapeList list;
+	for ( int i = 0; i < 10; ++i ) {
+
+		if ( i % 2 ) list.push_back( new Circle( i, i, 1 ) );
+		else list.push_back( new Rectangle( i, i, 2, 3 ) );
+	}
+
+	// three shapes a frame
+	{
+		AreaCalculator ac;
+		VisitTask task = accept_over_frames( list, ac );
+		task.setBudget( FrameBudget( 3 ) );
+
+		int frames = 0;
+		while ( task.resume() ) {
+
+			++frames;
+			cout << "frame " << frames << ": " << ac.visited << " shapes so far" << endl;
+		}
+		++frames;
+
+		cout << "total area " << ac.total << " over " << frames << " frames" << endl;
+		assert( ac.visited == 10 && frames == 4 );
+	}
+
+	// a time budget instead: however many fit in a millisecond
+	{
+		AreaCalculator ac;
+		VisitTask task = accept_over_frames( list, ac );
+		task.setBudget( FrameBudget( 0, chrono::milliseconds( 1 ) ) );
+
+		while ( task.resume() ) {}
+		assert( ac.visited == 10 );
+	}
+
+	// the slow one, spread over however many frames the disk needs
+	{
+		const char* path = "names.txt";
+		ofstream file( path );
+		AsyncExecutor io;
+		Namer namer;
+
+		VisitTask task = nameIntoFile( list, namer, file, io );
+		task.setBudget( FrameBudget( 4 ) );
+
+		int frames = 0, framesSpentWaiting = 0;
+		while ( task.resume() ) {
+
+			// the writes don't hold it up: the budget's four, and it gets four
+			assert( frames > 0 || namer.visited == 4 );
+			++frames;
+			if ( task.waiting() ) {
+				++framesSpentWaiting;
+			}
+
+			// the rest of the frame happens here
+			this_thread::sleep_for( chrono::microseconds( 100 ) );
+		}
+		file.close();
+
+		cout << "named everything in " << frames + 1 << " frames, "
+		     << framesSpentWaiting << " of them waiting on the disk" << endl;
+
+		ifstream written( path );
+		int lines = 0;
+		for ( string line; getline( written, line ); ) {
+			++lines;
+		}
+		assert( lines == 10 );
+		std::remove( path );
+	}
+
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		delete list[i];
+	}
+	return 0;
+}
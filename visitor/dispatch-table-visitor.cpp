@@ -0,0 +1,246 @@
+//
+//			The Dispatch Table Visitor
+//
+//	This is the Acyclic Visitor with the side-cast taken out.
+//
+//	In acyclic-visitor.cpp, every accept asks the visitor
+//	"are you a RectangleVisitor?" with a cast, every time,
+//	for every element. That's a lot of asking.
+//
+//	Here, every visitor writes down the answer once, when the
+//	first one of its kind is constructed: a table, indexed by
+//	the RTTI index of each visitable type, holding a little
+//	function (a thunk) that calls the right visit.
+//	Accepting is then just looking up your own slot and
+//	calling whatever's there. If nothing's there, the visitor
+//	doesn't visit you.
+//
+//	It's still acyclic. A new Shape gets a new RTTI index,
+//	and existing visitors simply don't have anything in that slot.
+//	Nobody gets recompiled, nobody gets hurt.
+//
+//	The catch is that a visitor with no Triangle visit just skips
+//	triangles. Sometimes you'd rather it treated a triangle as a
+//	plain old Shape, or a Square as a Rectangle. The fallback version
+//	works that out while it builds the table, so every type's slot
+//	holds the visit of its nearest ancestor the visitor does know.
+//	Same single lookup when visiting.
+//
+//	The machinery lives in dispatch-table.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cassert>
+
+#include "dispatch-table.h"
+#include "output-sink.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Shape;
+
+// The AbstractVisitor is now the table-driven kind.
+typedef TableVisitor<Shape> AbstractVisitor;
+
+// The base shape, again.
+// Shapes carry RTTI purely for the index.
+class Shape {
+	RTTI_DECLARE();
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+
+	virtual void accept( AbstractVisitor* av ) { }
+};
+
+// Each accept tells the visitor its index.
+// No casts, no asking.
+class Rectangle : public Shape {
+	RTTI_DECLARE();
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+
+	void accept( AbstractVisitor* av ) { av->dispatch( typeInfo.getIndex(), this ); }
+};
+
+class Circle : public Shape {
+	RTTI_DECLARE();
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+
+	void accept( AbstractVisitor* av ) { av->dispatch( typeInfo.getIndex(), this ); }
+};
+
+class Triangle : public Shape {
+	RTTI_DECLARE();
+public:
+	float b, h;
+	Triangle( float x, float y, float b, float h ) : Shape(x,y), b(b), h(h) {}
+
+	void accept( AbstractVisitor* av ) { av->dispatch( typeInfo.getIndex(), this ); }
+};
+
+// A special rectangle. Nobody writes a visit for it.
+class Square : public Rectangle {
+	RTTI_DECLARE();
+public:
+	Square( float x, float y, float side ) : Rectangle(x,y, side,side) {}
+
+	void accept( AbstractVisitor* av ) { av->dispatch( typeInfo.getIndex(), this ); }
+};
+
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Circle, Shape);
+RTTI_DEFINE(Triangle, Shape);
+RTTI_DEFINE(Square, Rectangle);
+
+// Instead of deriving from a specialized visitor per shape,
+// a visitor lists the shapes it visits.
+// Still no Triangle, still can't remember the formula.
+class AreaCalculator : public TableVisitorOf<AreaCalculator, Shape, Rectangle, Circle> {
+public:
+	AreaCalculator( OutputSink& out ) : out(out) {}
+
+	void visit( Rectangle* rectangle ) {
+
+		float area;
+		area = rectangle->w * rectangle->h;
+		out << "rectangle area is: " << area << '\n';
+	}
+
+	void visit( Circle* circle ) {
+
+		float area;
+		area = PI * circle->r * circle->r;
+		out << "circle area is: " << area << '\n';
+	}
+
+private:
+	OutputSink& out;
+};
+
+class Namer : public TableVisitorOf<Namer, Shape, Rectangle, Circle, Triangle> {
+public:
+	Namer( OutputSink& out ) : out(out) {}
+
+	void visit( Rectangle* rectangle ) {
+		out << "name: " << "rectangle" << '\n';
+	}
+
+	void visit( Circle* circle ) {
+		out << "name: " << "circle" << '\n';
+	}
+
+	void visit( Triangle* triangle ) {
+		out << "name: " << "triangle" << '\n';
+	}
+
+private:
+	OutputSink& out;
+};
+
+// Only cares about Rectangles, so that's the only slot it fills in.
+class RectangleCounter : public TableVisitorOf<RectangleCounter, Shape, Rectangle> {
+public:
+	float count;
+	RectangleCounter() : count(0) {}
+
+	void visit(Rectangle* rectangle) { ++count; }
+};
+
+// The AreaCalculator again, but anything it doesn't know
+// gets visited as whatever it does know that it came from.
+// Squares are Rectangles, Triangles are just Shapes.
+class FallbackAreaCalculator : public FallbackVisitorOf<FallbackAreaCalculator, Shape, Shape, Rectangle, Circle> {
+public:
+	FallbackAreaCalculator( OutputSink& out ) : out(out) {}
+
+	void visit( Shape* shape ) {
+		out << "some shape, no idea what its area is" << '\n';
+	}
+
+	void visit( Rectangle* rectangle ) {
+		out << "rectangle-ish area is: " << rectangle->w * rectangle->h << '\n';
+	}
+
+	void visit( Circle* circle ) {
+		out << "circle area is: " << PI * circle->r * circle->r << '\n';
+	}
+
+private:
+	OutputSink& out;
+};
+
+typedef vector<Shape*> ShapeList;
+
+int main() {
+
+	ShapeList list;
+	list.push_back( new Rectangle(0,0,10,20) );
+	list.push_back( new Rectangle(10,10, 5,3) );
+	list.push_back( new Circle( 5,5, 15) );
+	list.push_back( new Triangle(2,2, 4, 3.14) );
+
+	// visitors on the stack, output flushed once per traversal
+	OutputSink out( cout );
+	AreaCalculator ac( out );
+	Namer n( out );
+	RectangleCounter rc;
+
+	// areas
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &ac );
+	}
+	out.flush();
+
+	// name
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &n );
+	}
+	out.flush();
+
+	// counting
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &rc );
+	}
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	// a square and a triangle, with and without falling back
+	list.push_back( new Square(1,1, 4) );
+	FallbackAreaCalculator fac( out );
+
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &ac );
+	}
+	out << "(the plain AreaCalculator skipped the square and the triangle)" << '\n';
+
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &fac );
+	}
+	out.flush();
+
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+
+	// a sink with no room at all (or not enough) still gets everything through, in order
+	ostringstream tiny;
+	{
+		OutputSink none( tiny, 0 );
+		none << "no room, " << 42 << '\n';
+	}
+	{
+		OutputSink small( tiny, 4 );
+		small << "a bit of room, " << 4 << '\n';
+	}
+	assert( tiny.str() == "no room, 42\na bit of room, 4\n" );
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+#ifndef DISPATCH_TABLE_H
+#define DISPATCH_TABLE_H
+
+#include <vector>
+#include <cstddef>
+
+#include "../rtti/rtti.h"
+
+// A table of visit thunks, indexed by the visitable's RTTI index.
+// Empty slots are types the visitor doesn't visit.
+template<typename Visitable>
+class TableVisitor;
+
+template<typename Visitable>
+class DispatchTable {
+public:
+	typedef void (*Thunk)( TableVisitor<Visitable>* visitor, Visitable* visitable );
+
+	Thunk lookup( unsigned typeIndex ) const {
+
+		return typeIndex < m_thunks.size() ? m_thunks[typeIndex] : nullptr;
+	}
+
+	void set( unsigned typeIndex, Thunk thunk ) {
+
+		if ( typeIndex >= m_thunks.size() ) {
+
+			m_thunks.resize( typeIndex + 1, nullptr );
+		}
+		m_thunks[typeIndex] = thunk;
+	}
+
+private:
+	std::vector<Thunk> m_thunks;
+};
+
+// The base every table-driven visitor gets accepted as.
+// Visitables call dispatch with their own type index,
+// which is one indexed load and one indirect call.
+template<typename Visitable>
+class TableVisitor {
+public:
+	virtual ~TableVisitor() {}
+
+	void dispatch( unsigned typeIndex, Visitable* visitable ) {
+
+		typename DispatchTable<Visitable>::Thunk thunk = m_table->lookup( typeIndex );
+		if ( thunk ) {
+			thunk( this, visitable );
+		}
+	}
+
+protected:
+	TableVisitor( const DispatchTable<Visitable>* table ) : m_table( table ) {}
+
+private:
+	const DispatchTable<Visitable>* m_table;
+};
+
+// Derive from this with the list of types the visitor handles.
+// The table is built once per visitor class, the first time one is constructed,
+// and its thunks call Derived::visit directly so it can be inlined.
+template<typename Derived, typename Visitable, typename... Handled>
+class TableVisitorOf : public TableVisitor<Visitable> {
+public:
+	TableVisitorOf() : TableVisitor<Visitable>( &table() ) {}
+
+	static const DispatchTable<Visitable>& table() {
+
+		static const DispatchTable<Visitable> s_table = buildTable();
+		return s_table;
+	}
+
+private:
+	template<typename T>
+	static void thunk( TableVisitor<Visitable>* visitor, Visitable* visitable ) {
+
+		static_cast<Derived*>( visitor )->visit( static_cast<T*>( visitable ) );
+	}
+
+	static DispatchTable<Visitable> buildTable() {
+
+		DispatchTable<Visitable> table;
+		( table.set( Handled::typeInfo.getIndex(), &thunk<Handled> ), ... );
+		return table;
+	}
+};
+
+// Same as TableVisitorOf, except a type with no visit of its own is visited
+// as its nearest handled ancestor: list Shape and Rectangle and a Square
+// gets visit( Rectangle* ), a Triangle gets visit( Shape* ).
+//
+// The parent graph gets walked once, when the first visitor of the class is
+// constructed, and every registered type that derives from Visitable gets
+// a slot. Visiting is the same one lookup as ever; no derivesFrom per element.
+// If two handled ancestors are the same number of steps up, the one listed
+// first wins.
+//
+// Types registered after the table's built (say, by a plugin loaded later)
+// don't get slots, so they aren't visited.
+template<typename Derived, typename Visitable, typename... Handled>
+class FallbackVisitorOf : public TableVisitor<Visitable> {
+public:
+	FallbackVisitorOf() : TableVisitor<Visitable>( &table() ) {}
+
+	static const DispatchTable<Visitable>& table() {
+
+		static const DispatchTable<Visitable> s_table = buildTable();
+		return s_table;
+	}
+
+private:
+	typedef typename DispatchTable<Visitable>::Thunk Thunk;
+
+	template<typename T>
+	static void thunk( TableVisitor<Visitable>* visitor, Visitable* visitable ) {
+
+		static_cast<Derived*>( visitor )->visit( static_cast<T*>( visitable ) );
+	}
+
+	// the first handled type one level up at a time, or nullptr
+	static Thunk nearest( const RTTI& type, const RTTI* const* handled, const Thunk* thunks, std::size_t handledCount ) {
+
+		std::vector<const RTTI*> level( 1, &type );
+		while ( !level.empty() ) {
+
+			for ( std::size_t h = 0; h < handledCount; ++h ) {
+				for ( const RTTI* t : level ) {
+
+					if ( t == handled[h] ) {
+						return thunks[h];
+					}
+				}
+			}
+
+			std::vector<const RTTI*> next;
+			for ( const RTTI* t : level ) {
+				for ( unsigned p = 0; p < t->getParentCount(); ++p ) {
+					next.push_back( &t->getParent( p ) );
+				}
+			}
+			level.swap( next );
+		}
+
+		return nullptr;
+	}
+
+	static DispatchTable<Visitable> buildTable() {
+
+		const RTTI* const handled[] = { &Handled::typeInfo... };
+		const Thunk thunks[] = { &thunk<Handled>... };
+		const std::size_t handledCount = sizeof...( Handled );
+
+		DispatchTable<Visitable> table;
+		RTTIRegistry::forEach( [&]( const RTTI& type ) {
+
+			if ( type.derivesFrom( Visitable::typeInfo ) ) {
+
+				if ( Thunk found = nearest( type, handled, thunks, handledCount ) ) {
+					table.set( type.getIndex(), found );
+				}
+			}
+		} );
+		return table;
+	}
+};
+
+#endif
@@ -0,0 +1,97 @@
+//
+//			The Entity Query
+//
+//	Most of the visitors in here just want one kind of thing.
+//	The RectangleCounter looks at every shape in the list
+//	to find the rectangles, and counts them one at a time.
+//	Every frame. Ugh.
+//
+//	Instead, keep the shapes sorted by type as they're added
+//	and removed. Then "all the rectangles" is just the rectangle
+//	bucket (plus the buckets of anything deriving from Rectangle),
+//	and "how many rectangles" is a number that's already sitting there.
+//
+//	The machinery lives in type-indexed-list.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "type-indexed-list.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Shape {
+	RTTI_DECLARE();
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+};
+
+class Rectangle : public Shape {
+	RTTI_DECLARE();
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+};
+
+// Squares are rectangles, so they turn up in rectangle queries.
+class Square : public Rectangle {
+	RTTI_DECLARE();
+public:
+	Square( float x, float y, float side ) : Rectangle(x,y,side,side) {}
+};
+
+class Circle : public Shape {
+	RTTI_DECLARE();
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+};
+
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Square, Rectangle);
+RTTI_DEFINE(Circle, Shape);
+
+int main() {
+
+	Rectangle r1(0,0,10,20), r2(10,10, 5,3);
+	Square s(5,5, 3);
+	Circle c(5,5, 15);
+
+	TypeIndexedList<Shape> shapes;
+	shapes.insert( &r1 );
+	shapes.insert( &c );
+	shapes.insert( &s );
+	shapes.insert( &r2 );
+
+	// twice is once
+	assert( !shapes.insert( &c ) );
+	assert( shapes.size() == 4 );
+
+	// no looking, just reading off the count
+	cout << "there are " << shapes.count<Rectangle>() << " rectangles" << endl;
+	cout << "there are " << shapes.count<Shape>() << " shapes" << endl;
+
+	// only the rectangle and square buckets get touched
+	shapes.forEach<Rectangle>( []( Rectangle* rectangle ) {
+		cout << "rectangle area is: " << rectangle->w * rectangle->h << endl;
+	} );
+
+	shapes.forEach<Circle>( []( Circle* circle ) {
+		cout << "circle area is: " << PI * circle->r * circle->r << endl;
+	} );
+
+	// out goes the square, and with it the last one in its bucket
+	shapes.remove( &s );
+	assert( shapes.count<Square>() == 0 );
+	assert( shapes.query( Rectangle::typeInfo ).size() == 1 );
+	cout << "there are " << shapes.count<Rectangle>() << " rectangles left" << endl;
+
+	return 0;
+}
@@ -0,0 +1,342 @@
+#ifndef INCREMENTAL_VISIT_H
+#define INCREMENTAL_VISIT_H
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+
+class ChangeLog;
+
+// Something that can tell a ChangeLog it changed.
+// Call markDirty() from anything that mutates the object;
+// marking twice before anyone looks costs nothing extra.
+class Trackable {
+public:
+	Trackable() {}
+	virtual ~Trackable();
+
+	// copies start out untracked
+	Trackable( const Trackable& ) {}
+	Trackable& operator=( const Trackable& ) { return *this; }
+
+	// changed since one of its logs last looked
+	bool isDirty() const {
+
+		for ( std::size_t i = 0; i < m_memberships.size(); ++i ) {
+			if ( m_memberships[i].dirty ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+protected:
+	void markDirty();
+
+private:
+	friend class ChangeLog;
+
+	// One for every log it's tracked by, which is usually just the one.
+	struct Membership {
+		ChangeLog* log;
+		std::size_t trackedSlot;	// where it is in the log's lists,
+		std::size_t dirtySlot;		// so leaving them is a swap and a pop
+		bool dirty;
+
+		Membership( ChangeLog* log, std::size_t trackedSlot ) : log( log ), trackedSlot( trackedSlot ), dirtySlot( 0 ), dirty( false ) {}
+	};
+
+	Membership* membershipOf( const ChangeLog* log ) {
+
+		for ( std::size_t i = 0; i < m_memberships.size(); ++i ) {
+			if ( m_memberships[i].log == log ) {
+				return &m_memberships[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void leave( const ChangeLog* log ) {
+
+		Membership* membership = membershipOf( log );
+		*membership = m_memberships.back();
+		m_memberships.pop_back();
+	}
+
+	std::vector<Membership> m_memberships;
+};
+
+// The list of tracked objects that changed since someone last looked.
+// An object can be in any number of logs, and marking it dirty tells
+// all of them, so two caches over the same shapes both hear about it.
+//
+// Tracking, untracking and marking are all constant time (per log the
+// object is in). A tracked object that's destroyed untracks itself and
+// goes on a list of its own, so whoever keeps things per object can drop
+// them (see drainDestroyed).
+class ChangeLog {
+public:
+	ChangeLog() {}
+
+	~ChangeLog() {
+
+		for ( std::size_t i = 0; i < m_tracked.size(); ++i ) {
+			m_tracked[i]->leave( this );
+		}
+	}
+
+	ChangeLog( const ChangeLog& ) = delete;
+	ChangeLog& operator=( const ChangeLog& ) = delete;
+
+	void track( Trackable* object ) {
+
+		if ( !object->membershipOf( this ) ) {
+
+			object->m_memberships.push_back( Trackable::Membership( this, m_tracked.size() ) );
+			m_tracked.push_back( object );
+		}
+	}
+
+	void untrack( Trackable* object ) {
+
+		Trackable::Membership* membership = object->membershipOf( this );
+		if ( !membership ) {
+			return;
+		}
+
+		if ( membership->dirty ) {
+			swapOut( m_dirty, membership->dirtySlot, &Trackable::Membership::dirtySlot );
+		}
+		swapOut( m_tracked, membership->trackedSlot, &Trackable::Membership::trackedSlot );
+		object->leave( this );
+	}
+
+	std::size_t dirtyCount() const {
+
+		return m_dirty.size();
+	}
+
+	// Hands out everything that changed and starts over.
+	// fn can mark things dirty again, or untrack them, but mustn't
+	// destroy anything that's still to be handed out.
+	template<typename Fn>
+	void drain( Fn fn ) {
+
+		std::vector<Trackable*> dirty;
+		dirty.swap( m_dirty );
+
+		// none of these are in m_dirty any more
+		for ( std::size_t i = 0; i < dirty.size(); ++i ) {
+			dirty[i]->membershipOf( this )->dirty = false;
+		}
+
+		for ( std::size_t i = 0; i < dirty.size(); ++i ) {
+			fn( dirty[i] );
+		}
+
+		// hang on to the memory for next time
+		dirty.clear();
+		if ( m_dirty.empty() ) {
+			m_dirty.swap( dirty );
+		}
+	}
+
+	// Hands out every tracked object destroyed since last time, and starts over.
+	// They're gone: the pointers are only good for looking things up by.
+	template<typename Fn>
+	void drainDestroyed( Fn fn ) {
+
+		std::vector<Trackable*> destroyed;
+		destroyed.swap( m_destroyed );
+
+		for ( std::size_t i = 0; i < destroyed.size(); ++i ) {
+			fn( destroyed[i] );
+		}
+	}
+
+private:
+	friend class Trackable;
+
+	void add( Trackable* object, Trackable::Membership& membership ) {
+
+		membership.dirty = true;
+		membership.dirtySlot = m_dirty.size();
+		m_dirty.push_back( object );
+	}
+
+	void destroyed( Trackable* object ) {
+
+		untrack( object );
+		m_destroyed.push_back( object );
+	}
+
+	// the last one moves into the hole
+	void swapOut( std::vector<Trackable*>& list, std::size_t slot, std::size_t Trackable::Membership::* slotOf ) {
+
+		Trackable* last = list.back();
+		list[slot] = last;
+		last->membershipOf( this )->*slotOf = slot;
+		list.pop_back();
+	}
+
+	std::vector<Trackable*> m_tracked;
+	std::vector<Trackable*> m_dirty;
+	std::vector<Trackable*> m_destroyed;
+};
+
+inline Trackable::~Trackable() {
+
+	// each log takes its own membership out as it goes
+	while ( !m_memberships.empty() ) {
+		m_memberships.back().log->destroyed( this );
+	}
+}
+
+inline void Trackable::markDirty() {
+
+	for ( std::size_t i = 0; i < m_memberships.size(); ++i ) {
+
+		if ( !m_memberships[i].dirty ) {
+			m_memberships[i].log->add( this, m_memberships[i] );
+		}
+	}
+}
+
+// A visitor's answer for every element of a list, plus the total,
+// kept up to date by redoing only what changed.
+//
+// compute( element ) runs the visitor over one element and returns its
+// result. insert, remove and changed elements patch the total by the
+// difference, so a frame where three shapes moved costs three visits,
+// not a full sweep. Result needs +, - and a zero from Result().
+//
+// When more than half the elements changed, or when asked, it throws
+// the lot away and rebuilds from scratch, which is also what keeps
+// floating point drift in the running total from piling up.
+//
+// Elements destroyed while they're in here take their results with them;
+// remove() does the same without destroying anything.
+template<typename Base, typename Result>
+class IncrementalVisit {
+public:
+	typedef std::function<Result( Base* element )> Compute;
+
+	explicit IncrementalVisit( Compute compute ) : m_compute( compute ), m_total() {}
+
+	void insert( Base* element ) {
+
+		dropDestroyed();
+		m_log.track( element );
+
+		typename Results::iterator found = m_results.find( element );
+		if ( found != m_results.end() ) {
+			return;
+		}
+
+		const Result result = m_compute( element );
+		m_results.emplace( element, Entry( element, result ) );
+		m_total = m_total + result;
+	}
+
+	void remove( Base* element ) {
+
+		dropDestroyed();
+
+		typename Results::iterator found = m_results.find( element );
+		if ( found == m_results.end() ) {
+			return;
+		}
+
+		m_total = m_total - found->second.result;
+		m_results.erase( found );
+		m_log.untrack( element );
+	}
+
+	// revisits whatever was marked dirty since last time
+	void update() {
+
+		dropDestroyed();
+
+		if ( m_log.dirtyCount() * 2 > m_results.size() ) {
+
+			rebuild();
+			return;
+		}
+
+		m_log.drain( [this]( Trackable* changed ) {
+
+			Entry& cached = m_results.find( changed )->second;
+			const Result result = m_compute( cached.element );
+
+			m_total = m_total - cached.result + result;
+			cached.result = result;
+		} );
+	}
+
+	// the full sweep
+	void rebuild() {
+
+		dropDestroyed();
+		m_log.drain( []( Trackable* ) {} );
+
+		m_total = Result();
+		for ( typename Results::iterator i = m_results.begin(); i != m_results.end(); ++i ) {
+
+			i->second.result = m_compute( i->second.element );
+			m_total = m_total + i->second.result;
+		}
+	}
+
+	const Result& total() {
+
+		update();
+		return m_total;
+	}
+
+	// null if it's not in here
+	const Result* resultFor( Base* element ) {
+
+		update();
+		typename Results::const_iterator found = m_results.find( element );
+		return found != m_results.end() ? &found->second.result : nullptr;
+	}
+
+	std::size_t size() {
+
+		dropDestroyed();
+		return m_results.size();
+	}
+
+private:
+	struct Entry {
+		Base* element;
+		Result result;
+
+		Entry( Base* element, const Result& result ) : element( element ), result( result ) {}
+	};
+
+	// Keyed on the Trackable, so a destroyed element can still be found
+	// (by address alone) once there's no Base left to convert from.
+	typedef std::unordered_map<const Trackable*, Entry> Results;
+
+	void dropDestroyed() {
+
+		m_log.drainDestroyed( [this]( Trackable* gone ) {
+
+			typename Results::iterator found = m_results.find( gone );
+			if ( found != m_results.end() ) {
+
+				m_total = m_total - found->second.result;
+				m_results.erase( found );
+			}
+		} );
+	}
+
+	Compute m_compute;
+	ChangeLog m_log;
+	Results m_results;
+	Result m_total;
+};
+
+#endif
@@ -0,0 +1,164 @@
+//
+//		The Incremental Visitor
+//
+//	Most frames, most shapes don't change. So why work out
+//	the area of every shape, every frame, just to add them up
+//	to the same total as last time?
+//
+//	Instead, shapes put their hand up when they change
+//	(that's what the setters are for). A cache hangs on to the
+//	area of every shape plus the total, and when asked, it only
+//	revisits the shapes with their hands up, patching the total by
+//	the difference. Shapes that come and go patch it too.
+//
+//	If a whole lot changed at once it gives up and starts over,
+//	which is never slower than doing everything every frame.
+//
+//	The machinery lives in incremental-visit.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "incremental-visit.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Visitor;
+
+// Shapes are Trackable, and mutate through setters that mark them dirty.
+class Shape : public Trackable {
+	public:
+		virtual ~Shape() {}
+		Shape( float x, float y ) : x(x), y(y) {}
+
+		float getX() const { return x; }
+		float getY() const { return y; }
+		void moveTo( float newX, float newY ) { x = newX; y = newY; markDirty(); }
+
+		virtual void accept( Visitor* visitor ) = 0;
+
+	private:
+		float x, y;
+};
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+
+	float getW() const { return w; }
+	float getH() const { return h; }
+	void resize( float newW, float newH ) { w = newW; h = newH; markDirty(); }
+
+private:
+	float w, h;
+};
+
+class Circle : public Shape {
+public:
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+
+	float getR() const { return r; }
+	void setR( float newR ) { r = newR; markDirty(); }
+
+private:
+	float r;
+};
+
+// The same old AreaCalculator, except it remembers
+// the area of the last shape instead of printing it.
+class AreaCalculator : public Visitor {
+public:
+	float area;
+	AreaCalculator() : area(0) {}
+
+	void visit( Rectangle* rectangle ) { area = rectangle->getW() * rectangle->getH(); }
+	void visit( Circle* circle ) { area = PI * circle->getR() * circle->getR(); }
+};
+
+int main() {
+
+	Rectangle r1(0,0,10,20), r2(10,10, 5,3);
+	Circle c(5,5, 15);
+
+	// one visitor, reused for every element that needs a look
+	AreaCalculator ac;
+	IncrementalVisit<Shape, float> areas( [&ac]( Shape* shape ) {
+		shape->accept( &ac );
+		return ac.area;
+	} );
+
+	areas.insert( &r1 );
+	areas.insert( &r2 );
+	areas.insert( &c );
+	cout << "total area is: " << areas.total() << endl;
+
+	// only the rectangle that grew gets visited again
+	r2.resize( 6, 3 );
+	cout << "total area is: " << areas.total() << endl;
+
+	// moving doesn't change the area, but the cache doesn't know that; one visit
+	c.moveTo( 1, 1 );
+	cout << "total area is: " << areas.total() << endl;
+
+	// and leaving takes its area with it, no visits at all
+	areas.remove( &r1 );
+	cout << "total area is: " << areas.total() << endl;
+
+	// neither does getting destroyed without being removed first
+	{
+		Circle passingThrough( 0,0, 2 );
+		areas.insert( &passingThrough );
+		cout << "total area is: " << areas.total() << endl;
+	}
+	cout << "total area is: " << areas.total() << endl;
+
+	// the full sweep agrees
+	areas.rebuild();
+	cout << "total area from scratch is: " << areas.total() << endl;
+
+	// two caches over the same shapes both hear about every change
+	Rectangle r3(0,0, 2,2);
+	IncrementalVisit<Shape, float> rectangleAreas( [&ac]( Shape* shape ) {
+		shape->accept( &ac );
+		return ac.area;
+	} );
+	areas.insert( &r3 );
+	rectangleAreas.insert( &r2 );
+	rectangleAreas.insert( &r3 );
+	r3.resize( 3, 2 );
+	cout << "rectangle area is: " << rectangleAreas.total() << endl;
+	assert( rectangleAreas.total() == 18 + 6 );
+	assert( areas.resultFor( &r3 ) && *areas.resultFor( &r3 ) == 6 );
+
+	// and one going away doesn't leave the other, or the shapes, in a mess
+	{
+		IncrementalVisit<Shape, float> shortLived( [&ac]( Shape* shape ) {
+			shape->accept( &ac );
+			return ac.area;
+		} );
+		shortLived.insert( &r3 );
+		Circle alsoPassingThrough( 0,0, 1 );
+		shortLived.insert( &alsoPassingThrough );
+		rectangleAreas.insert( &alsoPassingThrough );
+	}
+	r3.resize( 1, 1 );
+	assert( rectangleAreas.size() == 2 && rectangleAreas.total() == 18 + 1 );
+	assert( *areas.resultFor( &r3 ) == 1 );
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+//
+//			The Message Bus
+//
+//	Components need to tell each other things. "You took 10 damage."
+//	"Something blew up over there." The obvious way is to loop
+//	over every component and ask each one if it cares, which
+//	means a cast per component per message. That gets old fast.
+//
+//	Here, a component type says up front which messages it wants
+//	and what to call when they show up. Messages get sent to the bus
+//	during the frame and sit in a queue per message type. At the end
+//	of the frame, each queue goes out to each type that asked for it,
+//	all at once: every HealthComponent gets every Damage message,
+//	then every SoundComponent gets them, and so on.
+//
+//	The machinery lives in message-bus.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "message-bus.h"
+
+using namespace std;
+
+// The messages. Plain data, plus RTTI so the bus can tell them apart.
+class Damage {
+	RTTI_DECLARE();
+public:
+	float amount;
+	Damage( float amount ) : amount(amount) {}
+};
+
+class Explosion {
+	RTTI_DECLARE();
+public:
+	float x, y;
+	Explosion( float x, float y ) : x(x), y(y) {}
+};
+
+// The components.
+class Component {
+	RTTI_DECLARE();
+public:
+	virtual ~Component() {}
+};
+
+class HealthComponent : public Component {
+	RTTI_DECLARE();
+public:
+	float health;
+	HealthComponent( float health ) : health(health) {}
+
+	void onDamage( const Damage& damage ) { health -= damage.amount; }
+};
+
+// A boss is a tougher HealthComponent. It hears about Damage
+// through its parent's subscription.
+class BossHealthComponent : public HealthComponent {
+	RTTI_DECLARE();
+public:
+	BossHealthComponent( float health ) : HealthComponent(health) {}
+};
+
+class SoundComponent : public Component {
+	RTTI_DECLARE();
+public:
+	int played;
+	SoundComponent() : played(0) {}
+
+	void onDamage( const Damage& damage ) { ++played; }
+	void onExplosion( const Explosion& explosion ) { ++played; }
+};
+
+// Only starts listening for explosions once something's hurt. It
+// subscribes from inside a handler, mid-delivery, which holds off
+// until the delivery's done.
+class AlarmComponent : public Component {
+	RTTI_DECLARE();
+public:
+	MessageBus<Component>& bus;
+	bool armed;
+	int explosionsHeard;
+	AlarmComponent( MessageBus<Component>& bus ) : bus(bus), armed(false), explosionsHeard(0) {}
+
+	void onDamage( const Damage& ) {
+		if ( !armed ) {
+			armed = true;
+			bus.subscribe( &AlarmComponent::onExplosion );
+		}
+	}
+	void onExplosion( const Explosion& ) { ++explosionsHeard; }
+};
+
+RTTI_DEFINE(Damage);
+RTTI_DEFINE(Explosion);
+RTTI_DEFINE(Component);
+RTTI_DEFINE(HealthComponent, Component);
+RTTI_DEFINE(BossHealthComponent, HealthComponent);
+RTTI_DEFINE(SoundComponent, Component);
+RTTI_DEFINE(AlarmComponent, Component);
+
+int main() {
+
+	HealthComponent grunt( 30 );
+	BossHealthComponent boss( 500 );
+	SoundComponent speaker;
+
+	MessageBus<Component> bus;
+	bus.attach( &grunt );
+	bus.attach( &boss );
+	bus.attach( &speaker );
+
+	AlarmComponent alarm( bus );
+	bus.attach( &alarm );
+	bus.subscribe( &AlarmComponent::onDamage );
+
+	bus.subscribe( &HealthComponent::onDamage );
+	bus.subscribe( &SoundComponent::onDamage );
+	bus.subscribe( &SoundComponent::onExplosion );
+
+	// one frame's worth of goings-on
+	bus.post( Damage( 10 ) );
+	bus.post( Explosion( 3, 4 ) );
+	bus.post( Damage( 5 ) );
+
+	// nothing's happened yet; it all goes out here
+	bus.deliver();
+
+	cout << "grunt health: " << grunt.health << endl;
+	cout << "boss health: " << boss.health << endl;
+	cout << "sounds played: " << speaker.played << endl;
+
+	// an empty frame delivers nothing
+	bus.deliver();
+	cout << "sounds played after a quiet frame: " << speaker.played << endl;
+
+	// the alarm armed itself during the first frame, so it missed that
+	// frame's explosion but hears this one
+	cout << "explosions the alarm heard in the first frame: " << alarm.explosionsHeard << endl;
+	bus.post( Explosion( 1, 1 ) );
+	bus.deliver();
+	cout << "explosions the alarm heard since: " << alarm.explosionsHeard << endl;
+
+	return 0;
+}
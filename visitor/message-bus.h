@@ -0,0 +1,190 @@
+#ifndef MESSAGE_BUS_H
+#define MESSAGE_BUS_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <cstddef>
+
+#include "../rtti/rtti.h"
+#include "type-indexed-list.h"
+
+// Messages for components, sorted by who gets them.
+//
+// A component type subscribes to a message type with one of its member
+// functions. Messages posted during a frame are queued by message type.
+// deliver() then hands each queue to each subscribed component type in
+// one go: every component of that type (subtypes included) gets every
+// message, in one tight loop with the handler known at compile time.
+//
+// Nobody ever asks a component "are you a HealthComponent?". The
+// components are kept sorted by RTTI type in a TypeIndexedList, so a
+// subscription goes straight to the right buckets.
+//
+// Messages posted while delivering wait for the next deliver(), and so
+// do subscriptions made while delivering: they're held to one side
+// until it's done, so a handler can subscribe without pulling the
+// subscription list out from under the loop that's calling it.
+// Message types need RTTI too, purely for the index.
+template<typename Component>
+class MessageBus {
+public:
+	MessageBus() : m_delivering( false ) {}
+
+	void attach( Component* component ) {
+
+		m_components.insert( component );
+	}
+
+	void detach( Component* component ) {
+
+		m_components.remove( component );
+	}
+
+	// Receiver::handler gets called with every Message, once per frame's worth
+	template<typename Receiver, typename Message>
+	void subscribe( void (Receiver::*handler)( const Message& message ) ) {
+
+		static_assert( rtti_derives_v<Receiver, Component>, "receivers have to be components" );
+
+		queue<Message>();
+		Subscription subscription( [handler]( const TypeIndexedList<Component>& components, const QueueBase& queued ) {
+
+			const std::vector<Message>& messages = static_cast<const Queue<Message>&>( queued ).delivering;
+			components.template forEach<Receiver>( [handler, &messages]( Receiver* receiver ) {
+
+				for ( std::size_t i = 0; i < messages.size(); ++i ) {
+					( receiver->*handler )( messages[i] );
+				}
+			} );
+		} );
+
+		if ( m_delivering ) {
+			m_laterSubscriptions.emplace_back( Message::typeInfo.getIndex(), std::move( subscription ) );
+		}
+		else {
+			subscriptionsFor( Message::typeInfo.getIndex() ).push_back( std::move( subscription ) );
+		}
+	}
+
+	template<typename Message>
+	void post( const Message& message ) {
+
+		queue<Message>().pending.push_back( message );
+	}
+
+	// everything posted since last time, batched by message type and then by receiver type
+	void deliver() {
+
+		for ( std::size_t i = 0; i < m_queues.size(); ++i ) {
+
+			if ( m_queues[i] ) {
+				m_queues[i]->startDelivering();
+			}
+		}
+
+		Delivering delivering( *this );
+
+		// Posting a new message type from a handler grows m_queues and
+		// m_subscriptions, so they're indexed afresh every time round.
+		// (The subscriptions themselves stay put: growing moves the inner
+		// vectors, and moving a vector doesn't move what's in it.)
+		const std::size_t queueCount = m_queues.size();
+		for ( std::size_t i = 0; i < queueCount; ++i ) {
+
+			if ( !m_queues[i] || m_queues[i]->deliveringCount() == 0 ) {
+				continue;
+			}
+
+			const std::size_t subscriptionCount = m_subscriptions[i].size();
+			for ( std::size_t s = 0; s < subscriptionCount; ++s ) {
+				m_subscriptions[i][s]( m_components, *m_queues[i] );
+			}
+		}
+	}
+
+	const TypeIndexedList<Component>& components() const {
+
+		return m_components;
+	}
+
+private:
+	class QueueBase {
+	public:
+		virtual ~QueueBase() {}
+		virtual void startDelivering() = 0;
+		virtual std::size_t deliveringCount() const = 0;
+	};
+
+	// pending fills up during the frame, delivering is what deliver() hands out
+	template<typename Message>
+	class Queue : public QueueBase {
+	public:
+		std::vector<Message> pending;
+		std::vector<Message> delivering;
+
+		// swapping keeps both vectors' memory around, so steady state doesn't allocate
+		void startDelivering() {
+
+			delivering.clear();
+			delivering.swap( pending );
+		}
+
+		std::size_t deliveringCount() const {
+
+			return delivering.size();
+		}
+	};
+
+	typedef std::function<void( const TypeIndexedList<Component>& components, const QueueBase& queued )> Subscription;
+
+	// for the length of a deliver(), exceptions and all
+	class Delivering {
+	public:
+		explicit Delivering( MessageBus& bus ) : m_bus( bus ) { m_bus.m_delivering = true; }
+
+		~Delivering() {
+
+			m_bus.m_delivering = false;
+			for ( std::size_t i = 0; i < m_bus.m_laterSubscriptions.size(); ++i ) {
+				m_bus.subscriptionsFor( m_bus.m_laterSubscriptions[i].first ).push_back( std::move( m_bus.m_laterSubscriptions[i].second ) );
+			}
+			m_bus.m_laterSubscriptions.clear();
+		}
+
+	private:
+		MessageBus& m_bus;
+	};
+
+	template<typename Message>
+	Queue<Message>& queue() {
+
+		const unsigned index = Message::typeInfo.getIndex();
+		subscriptionsFor( index );
+
+		if ( !m_queues[index] ) {
+			m_queues[index].reset( new Queue<Message>() );
+		}
+		return static_cast<Queue<Message>&>( *m_queues[index] );
+	}
+
+	std::vector<Subscription>& subscriptionsFor( unsigned index ) {
+
+		if ( index >= m_queues.size() ) {
+
+			m_queues.resize( index + 1 );
+			m_subscriptions.resize( index + 1 );
+		}
+		return m_subscriptions[index];
+	}
+
+	TypeIndexedList<Component> m_components;
+	std::vector<std::unique_ptr<QueueBase>> m_queues;
+	std::vector<std::vector<Subscription>> m_subscriptions;
+
+	bool m_delivering;
+	std::vector<std::pair<unsigned, Subscription>> m_laterSubscriptions;
+};
+
+#endif
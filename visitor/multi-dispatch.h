@@ -0,0 +1,247 @@
+#ifndef MULTI_DISPATCH_H
+#define MULTI_DISPATCH_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "../rtti/rtti.h"
+
+// Double dispatch on the RTTI of two objects, like a collision matrix.
+//
+// Handlers are registered for a pair of types and live in a table with
+// a row for every type under First and a column for every type under
+// Second, so dispatch is one lookup and one indirect call. (Rows and
+// columns are numbered as types turn up, so the table only grows with
+// the types it actually sees, not with every RTTI type in the program.)
+//
+// Pairs nobody registered fall back to the nearest handler whose types
+// the pair derives from (fewest steps up the two parent graphs, with ties
+// going to whoever registered first). That's worked out with derivesFrom
+// the first time the pair shows up, and written into the table.
+//
+// First and Second can be different hierarchies (shapes against visitors,
+// say), as long as both carry RTTI. When they're the same, add() covers
+// the swapped pair too, so ( Circle, Rectangle ) finds the
+// ( Rectangle, Circle ) handler with its arguments the right way around.
+//
+// Handlers get their arguments with a static_cast down from First and
+// Second, so those can't be virtual bases of the handled types.
+//
+// Dispatching fills in the table as it goes, so it's one thread at a time.
+// Call resolveAll() once every type is registered and from then on
+// dispatch only reads; types that show up later are still resolved on the spot.
+template<typename First, typename Second = First>
+class MultiDispatcher {
+public:
+	MultiDispatcher() : m_columnCapacity( 0 ) {}
+
+	template<typename A, typename B>
+	void add( void (*handler)( A& a, B& b ) ) {
+
+		static_assert( rtti_derives_v<A, First> && rtti_derives_v<B, Second>, "handler types have to be in the hierarchies" );
+
+		m_handlers.push_back( Handler( &A::typeInfo, &B::typeInfo, &call<A, B>, reinterpret_cast<Erased>( handler ), false ) );
+
+		if constexpr ( std::is_same<First, Second>::value ) {
+
+			if ( &A::typeInfo != &B::typeInfo ) {
+				m_handlers.push_back( Handler( &B::typeInfo, &A::typeInfo, &call<A, B>, reinterpret_cast<Erased>( handler ), true ) );
+			}
+		}
+
+		// whatever the table worked out before might not be nearest any more
+		std::fill( m_cells.begin(), m_cells.end(), UNRESOLVED );
+	}
+
+	// false if no handler fits
+	bool dispatch( First& a, Second& b ) {
+
+		const std::size_t row = rowFor( a.getTypeInfo() );
+		const std::size_t column = columnFor( b.getTypeInfo() );
+
+		std::int32_t& cell = m_cells[row * m_columnCapacity + column];
+		if ( cell == UNRESOLVED ) {
+			cell = resolve( a.getTypeInfo(), b.getTypeInfo() );
+		}
+
+		if ( cell == NO_HANDLER ) {
+			return false;
+		}
+
+		const Handler& handler = m_handlers[cell];
+		handler.thunk( handler.function, handler.swapped, &a, &b );
+		return true;
+	}
+
+	// fills in every pair of types registered so far
+	void resolveAll() {
+
+		RTTIRegistry::forEach( [this]( const RTTI& type ) {
+
+			if ( type.derivesFrom( First::typeInfo ) ) {
+				rowFor( type );
+			}
+			if ( type.derivesFrom( Second::typeInfo ) ) {
+				columnFor( type );
+			}
+		} );
+
+		for ( std::size_t row = 0; row < m_rows.size(); ++row ) {
+			for ( std::size_t column = 0; column < m_columns.size(); ++column ) {
+
+				std::int32_t& cell = m_cells[row * m_columnCapacity + column];
+				if ( cell == UNRESOLVED ) {
+					cell = resolve( *m_rows[row], *m_columns[column] );
+				}
+			}
+		}
+	}
+
+	// how many types have turned up on each side
+	std::size_t rowCount() const { return m_rows.size(); }
+	std::size_t columnCount() const { return m_columns.size(); }
+
+private:
+	static constexpr std::int32_t UNRESOLVED = -2;
+	static constexpr std::int32_t NO_HANDLER = -1;
+
+	typedef void (*Erased)();
+	typedef void (*Thunk)( Erased function, bool swapped, void* a, void* b );
+
+	struct Handler {
+		Handler( const RTTI* first, const RTTI* second, Thunk thunk, Erased function, bool swapped )
+			: first( first ), second( second ), thunk( thunk ), function( function ), swapped( swapped ) {}
+
+		const RTTI* first;
+		const RTTI* second;
+		Thunk thunk;
+		Erased function;
+		bool swapped;
+	};
+
+	// a and b are a First* and a Second*, or the other way around when swapped
+	template<typename A, typename B>
+	static void call( Erased function, bool swapped, void* a, void* b ) {
+
+		void (*handler)( A&, B& ) = reinterpret_cast<void (*)( A&, B& )>( function );
+		if ( swapped ) {
+			handler( *static_cast<A*>( static_cast<First*>( b ) ), *static_cast<B*>( static_cast<Second*>( a ) ) );
+		}
+		else {
+			handler( *static_cast<A*>( static_cast<First*>( a ) ), *static_cast<B*>( static_cast<Second*>( b ) ) );
+		}
+	}
+
+	// how many steps up from type to ancestor, or -1 if it isn't one
+	static int distance( const RTTI& type, const RTTI& ancestor ) {
+
+		if ( !type.derivesFrom( ancestor ) ) {
+			return -1;
+		}
+
+		std::vector<const RTTI*> level( 1, &type );
+		for ( int steps = 0; !level.empty(); ++steps ) {
+
+			std::vector<const RTTI*> next;
+			for ( const RTTI* t : level ) {
+
+				if ( t == &ancestor ) {
+					return steps;
+				}
+
+				for ( unsigned p = 0; p < t->getParentCount(); ++p ) {
+					next.push_back( &t->getParent( p ) );
+				}
+			}
+			level.swap( next );
+		}
+
+		return -1;
+	}
+
+	std::int32_t resolve( const RTTI& a, const RTTI& b ) const {
+
+		std::int32_t best = NO_HANDLER;
+		int bestDistance = 0;
+
+		for ( std::size_t h = 0; h < m_handlers.size(); ++h ) {
+
+			const int da = distance( a, *m_handlers[h].first );
+			const int db = distance( b, *m_handlers[h].second );
+			if ( da < 0 || db < 0 ) {
+				continue;
+			}
+
+			if ( best == NO_HANDLER || da + db < bestDistance ) {
+				best = static_cast<std::int32_t>( h );
+				bestDistance = da + db;
+			}
+		}
+
+		return best;
+	}
+
+	// the row or column numbers, by RTTI index, or -1 for types not seen yet
+	static std::int32_t numberOf( const std::vector<std::int32_t>& numbers, unsigned index ) {
+
+		return index < numbers.size() ? numbers[index] : -1;
+	}
+
+	static void number( std::vector<std::int32_t>& numbers, std::vector<const RTTI*>& types, const RTTI& type ) {
+
+		const unsigned index = type.getIndex();
+		if ( index >= numbers.size() ) {
+			numbers.resize( index + 1, -1 );
+		}
+		numbers[index] = static_cast<std::int32_t>( types.size() );
+		types.push_back( &type );
+	}
+
+	std::size_t rowFor( const RTTI& type ) {
+
+		std::int32_t row = numberOf( m_rowOf, type.getIndex() );
+		if ( row < 0 ) {
+
+			number( m_rowOf, m_rows, type );
+			m_cells.resize( m_rows.size() * m_columnCapacity, UNRESOLVED );
+			row = static_cast<std::int32_t>( m_rows.size() - 1 );
+		}
+		return std::size_t( row );
+	}
+
+	// columns come in twos, fours, eights... so a new one seldom means re-laying the rows
+	std::size_t columnFor( const RTTI& type ) {
+
+		std::int32_t column = numberOf( m_columnOf, type.getIndex() );
+		if ( column < 0 ) {
+
+			number( m_columnOf, m_columns, type );
+			if ( m_columns.size() > m_columnCapacity ) {
+
+				const std::size_t capacity = std::max<std::size_t>( 4, m_columnCapacity * 2 );
+				std::vector<std::int32_t> cells( m_rows.size() * capacity, UNRESOLVED );
+				for ( std::size_t row = 0; row < m_rows.size(); ++row ) {
+					std::copy( m_cells.begin() + row * m_columnCapacity, m_cells.begin() + ( row + 1 ) * m_columnCapacity, cells.begin() + row * capacity );
+				}
+
+				m_cells.swap( cells );
+				m_columnCapacity = capacity;
+			}
+			column = static_cast<std::int32_t>( m_columns.size() - 1 );
+		}
+		return std::size_t( column );
+	}
+
+	std::vector<Handler> m_handlers;
+
+	std::vector<std::int32_t> m_rowOf, m_columnOf;
+	std::vector<const RTTI*> m_rows, m_columns;
+
+	// m_rows.size() by m_columnCapacity
+	std::vector<std::int32_t> m_cells;
+	std::size_t m_columnCapacity;
+};
+
+#endif
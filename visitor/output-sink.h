@@ -0,0 +1,102 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <ostream>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+
+// A place for visitors to write their output that isn't cout.
+//
+// Writing is copying into a buffer that's allocated once, up front.
+// Nothing reaches the stream until flush(), so a traversal that prints
+// a line per shape does one write at the end instead of a flush per endl.
+// If the buffer fills up in the middle, it quietly flushes what it has
+// and keeps going; it never grows. Text too big for the buffer goes
+// straight to the stream, and a capacity of 0 is taken as 1.
+//
+// Numbers come out the way cout prints them by default (%g).
+class OutputSink {
+public:
+	explicit OutputSink( std::ostream& out, std::size_t capacity = 4096 )
+		: m_out( out ), m_buffer( new char[capacity ? capacity : 1] ), m_capacity( capacity ? capacity : 1 ), m_used( 0 ) {}
+
+	~OutputSink() {
+
+		flush();
+	}
+
+	OutputSink( const OutputSink& ) = delete;
+	OutputSink& operator=( const OutputSink& ) = delete;
+
+	OutputSink& operator<<( const char* text ) {
+
+		write( text, std::strlen( text ) );
+		return *this;
+	}
+
+	OutputSink& operator<<( char c ) {
+
+		write( &c, 1 );
+		return *this;
+	}
+
+	OutputSink& operator<<( double number ) {
+
+		char digits[32];
+		const int length = std::snprintf( digits, sizeof( digits ), "%g", number );
+		write( digits, length );
+		return *this;
+	}
+
+	OutputSink& operator<<( long number ) {
+
+		char digits[24];
+		const int length = std::snprintf( digits, sizeof( digits ), "%ld", number );
+		write( digits, length );
+		return *this;
+	}
+
+	OutputSink& operator<<( float number ) { return *this << double( number ); }
+	OutputSink& operator<<( int number ) { return *this << long( number ); }
+
+	// one write for everything since the last flush
+	void flush() {
+
+		drain();
+		m_out.flush();
+	}
+
+private:
+	void write( const char* text, std::size_t length ) {
+
+		if ( length > m_capacity - m_used ) {
+
+			drain();
+			if ( length >= m_capacity ) {
+				m_out.write( text, length );
+				return;
+			}
+		}
+
+		std::memcpy( m_buffer.get() + m_used, text, length );
+		m_used += length;
+	}
+
+	void drain() {
+
+		if ( m_used ) {
+
+			m_out.write( m_buffer.get(), m_used );
+			m_used = 0;
+		}
+	}
+
+	std::ostream& m_out;
+	std::unique_ptr<char[]> m_buffer;
+	const std::size_t m_capacity;
+	std::size_t m_used;
+};
+
+#endif
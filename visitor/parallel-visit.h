@@ -0,0 +1,250 @@
+#ifndef PARALLEL_VISIT_H
+#define PARALLEL_VISIT_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+// A small work-stealing thread pool.
+//
+// Every worker has its own queue. It works from the back of its own,
+// and when that runs dry it steals from the front of somebody else's,
+// so a worker stuck with slow chunks gets helped out by the idle ones.
+// The thread that calls run() pitches in as worker 0.
+//
+// run() is one batch at a time; it blocks until every task is done
+// and rethrows the first exception any of them threw.
+class WorkStealingPool {
+public:
+	typedef std::function<void( unsigned worker )> Task;
+
+	explicit WorkStealingPool( unsigned workers = std::max( 1u, std::thread::hardware_concurrency() ) )
+		: m_queues( new Queue[workers] ), m_workerCount( workers ), m_pending( 0 ), m_generation( 0 ), m_stop( false )
+	{
+		for ( unsigned id = 1; id < workers; ++id ) {
+			m_threads.emplace_back( [this, id] { workerLoop( id ); } );
+		}
+	}
+
+	~WorkStealingPool() {
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_stop = true;
+		}
+		m_wake.notify_all();
+
+		for ( std::size_t i = 0; i < m_threads.size(); ++i ) {
+			m_threads[i].join();
+		}
+	}
+
+	WorkStealingPool( const WorkStealingPool& ) = delete;
+	WorkStealingPool& operator=( const WorkStealingPool& ) = delete;
+
+	unsigned workerCount() const {
+
+		return m_workerCount;
+	}
+
+	void run( std::vector<Task>& tasks ) {
+
+		std::lock_guard<std::mutex> batch( m_runMutex );
+		if ( tasks.empty() ) {
+			return;
+		}
+
+		m_error = nullptr;
+		m_pending.store( tasks.size() );
+		for ( std::size_t i = 0; i < tasks.size(); ++i ) {
+
+			Queue& queue = m_queues[i % m_workerCount];
+			std::lock_guard<std::mutex> lock( queue.mutex );
+			queue.tasks.push_back( std::move( tasks[i] ) );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		// help out until there's nothing left to take, then wait for the stragglers
+		Task task;
+		while ( take( 0, task ) ) {
+			execute( 0, task );
+		}
+
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_done.wait( lock, [this] { return m_pending.load() == 0; } );
+
+		if ( m_error ) {
+			std::rethrow_exception( m_error );
+		}
+	}
+
+	// One pool for everybody who doesn't bring their own.
+	static WorkStealingPool& shared() {
+
+		static WorkStealingPool s_pool;
+		return s_pool;
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	bool take( unsigned id, Task& task ) {
+
+		{
+			Queue& own = m_queues[id];
+			std::lock_guard<std::mutex> lock( own.mutex );
+			if ( !own.tasks.empty() ) {
+				task = std::move( own.tasks.back() );
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+
+		for ( unsigned i = 1; i < m_workerCount; ++i ) {
+
+			Queue& victim = m_queues[( id + i ) % m_workerCount];
+			std::lock_guard<std::mutex> lock( victim.mutex );
+			if ( !victim.tasks.empty() ) {
+				task = std::move( victim.tasks.front() );
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void execute( unsigned id, Task& task ) {
+
+		try {
+			task( id );
+		}
+		catch ( ... ) {
+			std::lock_guard<std::mutex> lock( m_mutex );
+			if ( !m_error ) {
+				m_error = std::current_exception();
+			}
+		}
+
+		task = nullptr;
+		if ( m_pending.fetch_sub( 1 ) == 1 ) {
+
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_done.notify_all();
+		}
+	}
+
+	void workerLoop( unsigned id ) {
+
+		unsigned long seen = 0;
+		Task task;
+
+		for ( ;; ) {
+
+			while ( take( id, task ) ) {
+				execute( id, task );
+			}
+
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_wake.wait( lock, [this, &seen] { return m_stop || m_generation != seen; } );
+			if ( m_stop ) {
+				return;
+			}
+			seen = m_generation;
+		}
+	}
+
+	std::unique_ptr<Queue[]> m_queues;
+	const unsigned m_workerCount;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_runMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	std::atomic<std::size_t> m_pending;
+	unsigned long m_generation;
+	bool m_stop;
+	std::exception_ptr m_error;
+};
+
+// Visits a ShapeList in parallel.
+//
+// The list is cut into chunks of `grain` shapes and the chunks are spread
+// over the pool. Each worker makes its own visitor with factory() the first
+// time it picks up a chunk, so stateful visitors like the RectangleCounter
+// never share their state. When it's all over, the workers' visitors
+// are folded into one with reduce( into, from ) and that one is returned.
+// The fold goes in worker order, but which shapes a worker saw depends
+// on who stole what, so reduce should not care about order.
+template<typename ShapeType, typename Factory, typename Reduce>
+auto for_each_accept( WorkStealingPool& pool, const std::vector<ShapeType*>& list,
+	Factory factory, Reduce reduce, std::size_t grain = 4096 ) -> decltype( factory() ) {
+
+	typedef decltype( factory() ) VisitorType;
+
+	std::vector<std::optional<VisitorType>> visitors( pool.workerCount() );
+	std::vector<WorkStealingPool::Task> tasks;
+	grain = std::max<std::size_t>( grain, 1 );
+
+	for ( std::size_t begin = 0; begin < list.size(); begin += grain ) {
+
+		const std::size_t end = std::min( begin + grain, list.size() );
+		tasks.push_back( [&list, &visitors, &factory, begin, end]( unsigned worker ) {
+
+			std::optional<VisitorType>& visitor = visitors[worker];
+			if ( !visitor ) {
+				visitor.emplace( factory() );
+			}
+
+			for ( std::size_t i = begin; i < end; ++i ) {
+				list[i]->accept( &*visitor );
+			}
+		} );
+	}
+
+	pool.run( tasks );
+
+	std::optional<VisitorType> result;
+	for ( std::size_t i = 0; i < visitors.size(); ++i ) {
+
+		if ( !visitors[i] ) {
+			continue;
+		}
+
+		if ( result ) {
+			reduce( *result, *visitors[i] );
+		}
+		else {
+			result.emplace( std::move( *visitors[i] ) );
+		}
+	}
+
+	return result ? std::move( *result ) : factory();
+}
+
+template<typename ShapeType, typename Factory, typename Reduce>
+auto for_each_accept( const std::vector<ShapeType*>& list, Factory factory, Reduce reduce,
+	std::size_t grain = 4096 ) -> decltype( factory() ) {
+
+	return for_each_accept( WorkStealingPool::shared(), list, factory, reduce, grain );
+}
+
+#endif
@@ -0,0 +1,111 @@
+//
+//		The Parallel Visitor
+//
+//	The RectangleCounter keeps its count in a member, which is
+//	great until two threads try to bump it at the same time.
+//
+//	So don't share it. Give every thread its own visitor,
+//	let each one count its own share of the list, and then
+//	add the counts together at the end. That's all a
+//	"reduction" is: squishing a bunch of partial answers
+//	into one answer.
+//
+//	The splitting up and the thread wrangling live in
+//	parallel-visit.h. The visitors don't know any of it is happening.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "shape-pool.h"
+#include "parallel-visit.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Visitor;
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* visitor ) = 0;
+};
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+// The same old RectangleCounter. Nothing thread-y about it.
+class RectangleCounter : public Visitor {
+public:
+	float count;
+	RectangleCounter() : count(0) {}
+
+	void visit(Circle* circle) {}
+	void visit(Rectangle* rectangle) { ++count; }
+};
+
+// And an AreaCalculator that adds up instead of printing,
+// since a million lines of output from a dozen threads
+// is nobody's idea of a good time.
+class AreaCalculator : public Visitor {
+public:
+	double total;
+	AreaCalculator() : total(0) {}
+
+	void visit( Rectangle* rectangle ) { total += rectangle->w * rectangle->h; }
+	void visit( Circle* circle ) { total += PI * circle->r * circle->r; }
+};
+
+typedef vector<Shape*> ShapeList;
+
+int main() {
+
+	// a whole lot of shapes this time
+	ShapePool<Rectangle, Circle> shapes;
+	ShapeList list;
+	for ( int i = 0; i < 1000000; ++i ) {
+		if ( i % 3 == 0 ) list.push_back( shapes.create<Circle>( i, i, 1 ) );
+		else list.push_back( shapes.create<Rectangle>( i, i, 2, 3 ) );
+	}
+
+	// Each worker gets a fresh RectangleCounter from the factory,
+	// and the reduce adds one counter's count into another's.
+	RectangleCounter rc = for_each_accept( list,
+		[] { return RectangleCounter(); },
+		[]( RectangleCounter& into, const RectangleCounter& from ) { into.count += from.count; } );
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	AreaCalculator ac = for_each_accept( list,
+		[] { return AreaCalculator(); },
+		[]( AreaCalculator& into, const AreaCalculator& from ) { into.total += from.total; } );
+	cout << "total area is: " << ac.total << endl;
+
+	list.clear();
+	shapes.clear();
+
+	return 0;
+}
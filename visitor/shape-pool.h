@@ -0,0 +1,452 @@
+#ifndef SHAPE_POOL_H
+#define SHAPE_POOL_H
+
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Where a pool's chunks come from. The default is the heap;
+// sharded-list.h hands out ones that put the chunks on a NUMA node.
+struct ChunkAllocator {
+	typedef void* (*Allocate)( std::size_t bytes, std::size_t alignment, void* context );
+	typedef void (*Release)( void* chunk, std::size_t bytes, std::size_t alignment, void* context );
+
+	Allocate allocate;
+	Release release;
+	void* context;
+
+	ChunkAllocator() : allocate( &heapAllocate ), release( &heapRelease ), context( nullptr ) {}
+	ChunkAllocator( Allocate allocate, Release release, void* context ) : allocate( allocate ), release( release ), context( context ) {}
+
+private:
+	static void* heapAllocate( std::size_t bytes, std::size_t alignment, void* ) {
+
+		return ::operator new( bytes, std::align_val_t( alignment ) );
+	}
+
+	static void heapRelease( void* chunk, std::size_t, std::size_t alignment, void* ) {
+
+		::operator delete( chunk, std::align_val_t( alignment ) );
+	}
+};
+
+// How to build a Pool.
+struct PoolSettings {
+	std::size_t chunkSize;
+	ChunkAllocator allocator;
+
+	PoolSettings( std::size_t chunkSize = 1024, const ChunkAllocator& allocator = ChunkAllocator() )
+		: chunkSize( chunkSize ), allocator( allocator ) {}
+};
+
+// A pool of T's, handed out from big chunks so they sit next to each other
+// instead of wherever the heap feels like putting them.
+//
+// The pool owns everything it creates. Free one with destroy(),
+// or all of them at once with clear(), which is a loop over the
+// chunks rather than a free() per object.
+//
+// forEach walks the live objects in slot order, which is allocation order
+// until something gets destroyed and its slot reused. Either way it's
+// front to back through memory, so visitor sweeps stay cache-linear.
+//
+// For scoped ownership, make() hands back a Handle that destroys its
+// object when it goes away. Let go of the handles before clear()ing.
+//
+// relocate() packs the live objects into fresh chunks with no gaps,
+// in whatever order you like. That moves them, so it's for between
+// frames, when you can fix up every pointer you're holding.
+template<typename T>
+class Pool {
+public:
+	struct Deleter {
+		Pool* pool;
+		void operator()( T* object ) const { pool->destroy( object ); }
+	};
+
+	typedef std::unique_ptr<T, Deleter> Handle;
+
+	explicit Pool( std::size_t chunkSize = 1024 )
+		: m_chunkSize( chunkSize ), m_highWater( 0 ), m_size( 0 ), m_generation( 0 )
+	{}
+
+	explicit Pool( const PoolSettings& settings )
+		: m_chunkSize( settings.chunkSize ), m_allocator( settings.allocator ), m_highWater( 0 ), m_size( 0 ), m_generation( 0 )
+	{}
+
+	~Pool() { clear(); }
+
+	Pool( const Pool& ) = delete;
+	Pool& operator=( const Pool& ) = delete;
+
+	template<typename... Args>
+	T* create( Args&&... args ) {
+
+		const std::size_t slot = takeSlot();
+
+		T* object;
+		try {
+			object = new ( address( slot ) ) T( std::forward<Args>( args )... );
+		}
+		catch ( ... ) {
+			m_free.push_back( slot );
+			throw;
+		}
+
+		m_live[slot / 64] |= std::uint64_t( 1 ) << ( slot % 64 );
+		++m_size;
+		++m_generation;
+		return object;
+	}
+
+	template<typename... Args>
+	Handle make( Args&&... args ) {
+
+		return Handle( create( std::forward<Args>( args )... ), Deleter{ this } );
+	}
+
+	void destroy( T* object ) {
+
+		const std::size_t slot = slotOf( object );
+		object->~T();
+
+		m_live[slot / 64] &= ~( std::uint64_t( 1 ) << ( slot % 64 ) );
+		m_free.push_back( slot );
+		--m_size;
+		++m_generation;
+	}
+
+	// Bulk free: run the destructors in one sweep, then hand back the chunks.
+	void clear() {
+
+		forEach( []( T* object ) { object->~T(); } );
+
+		for ( std::size_t i = 0; i < m_chunks.size(); ++i ) {
+			releaseChunk( m_chunks[i] );
+		}
+
+		m_chunks.clear();
+		m_chunksByAddress.clear();
+		m_live.clear();
+		m_free.clear();
+		m_highWater = 0;
+		m_size = 0;
+		++m_generation;
+	}
+
+	template<typename Fn>
+	void forEach( Fn fn ) {
+
+		for ( std::size_t word = 0; word < m_live.size(); ++word ) {
+
+			std::uint64_t bits = m_live[word];
+			while ( bits ) {
+
+				const std::size_t slot = word * 64 + __builtin_ctzll( bits );
+				fn( static_cast<T*>( address( slot ) ) );
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	std::size_t size() const {
+
+		return m_size;
+	}
+
+	// Goes up every time an object is created, destroyed or moved, so
+	// "same address as last time" can be told apart from "same object".
+	std::uint64_t generation() const {
+
+		return m_generation;
+	}
+
+	// takes any pointer, so you can ask about a Shape* that might not be a T
+	bool owns( const void* object ) const {
+
+		return findChunk( object ) != m_chunks.size();
+	}
+
+	// Moves the objects in order to the front of fresh chunks, one after
+	// another, then every other live object after them. Returns where each
+	// of order ended up. Every pointer into the pool is stale afterwards,
+	// and order must not name an object twice.
+	std::vector<T*> relocate( const std::vector<T*>& order ) {
+
+		// whatever's left in here once order's slots are taken out is "the rest"
+		std::vector<std::uint64_t> rest( m_live );
+		for ( std::size_t i = 0; i < order.size(); ++i ) {
+
+			const std::size_t slot = slotOf( order[i] );
+			rest[slot / 64] &= ~( std::uint64_t( 1 ) << ( slot % 64 ) );
+		}
+
+		std::vector<T*> chunks( ( m_size + m_chunkSize - 1 ) / m_chunkSize );
+		for ( std::size_t i = 0; i < chunks.size(); ++i ) {
+			chunks[i] = allocateChunk();
+		}
+
+		std::size_t next = 0;
+		auto move = [this, &chunks, &next]( T* object ) {
+
+			T* moved = new ( chunks[next / m_chunkSize] + next % m_chunkSize ) T( std::move( *object ) );
+			object->~T();
+			++next;
+			return moved;
+		};
+
+		std::vector<T*> moved;
+		moved.reserve( order.size() );
+		for ( std::size_t i = 0; i < order.size(); ++i ) {
+			moved.push_back( move( order[i] ) );
+		}
+
+		for ( std::size_t word = 0; word < rest.size(); ++word ) {
+			for ( std::uint64_t bits = rest[word]; bits; bits &= bits - 1 ) {
+				move( static_cast<T*>( address( word * 64 + __builtin_ctzll( bits ) ) ) );
+			}
+		}
+
+		for ( std::size_t i = 0; i < m_chunks.size(); ++i ) {
+			releaseChunk( m_chunks[i] );
+		}
+
+		m_chunks.swap( chunks );
+		m_chunksByAddress.clear();
+		for ( std::size_t i = 0; i < m_chunks.size(); ++i ) {
+			m_chunksByAddress.push_back( std::pair<const T*, std::size_t>( m_chunks[i], i ) );
+		}
+		std::sort( m_chunksByAddress.begin(), m_chunksByAddress.end() );
+
+		m_live.assign( ( m_chunks.size() * m_chunkSize + 63 ) / 64, 0 );
+		for ( std::size_t slot = 0; slot < next; ++slot ) {
+			m_live[slot / 64] |= std::uint64_t( 1 ) << ( slot % 64 );
+		}
+
+		m_free.clear();
+		m_highWater = next;
+		++m_generation;
+		return moved;
+	}
+
+private:
+	std::size_t takeSlot() {
+
+		if ( !m_free.empty() ) {
+
+			const std::size_t slot = m_free.back();
+			m_free.pop_back();
+			return slot;
+		}
+
+		if ( m_highWater == m_chunks.size() * m_chunkSize ) {
+
+			addChunk();
+		}
+
+		return m_highWater++;
+	}
+
+	void addChunk() {
+
+		T* chunk = allocateChunk();
+		const std::size_t index = m_chunks.size();
+		m_chunks.push_back( chunk );
+
+		// kept sorted by address so destroy can find the chunk with a binary search
+		std::pair<const T*, std::size_t> entry( chunk, index );
+		m_chunksByAddress.insert( std::upper_bound( m_chunksByAddress.begin(), m_chunksByAddress.end(), entry ), entry );
+
+		m_live.resize( ( m_chunks.size() * m_chunkSize + 63 ) / 64, 0 );
+	}
+
+	T* allocateChunk() {
+
+		return static_cast<T*>( m_allocator.allocate( sizeof( T ) * m_chunkSize, alignof( T ), m_allocator.context ) );
+	}
+
+	void releaseChunk( T* chunk ) {
+
+		m_allocator.release( chunk, sizeof( T ) * m_chunkSize, alignof( T ), m_allocator.context );
+	}
+
+	void* address( std::size_t slot ) const {
+
+		return m_chunks[slot / m_chunkSize] + slot % m_chunkSize;
+	}
+
+	std::size_t findChunk( const void* object ) const {
+
+		const char* at = static_cast<const char*>( object );
+		auto after = std::upper_bound( m_chunksByAddress.begin(), m_chunksByAddress.end(), at,
+			[]( const char* address, const std::pair<const T*, std::size_t>& chunk ) {
+				return address < reinterpret_cast<const char*>( chunk.first );
+			} );
+		if ( after == m_chunksByAddress.begin() ) {
+
+			return m_chunks.size();
+		}
+
+		--after;
+		return at < reinterpret_cast<const char*>( after->first + m_chunkSize ) ? after->second : m_chunks.size();
+	}
+
+	std::size_t slotOf( const T* object ) const {
+
+		const std::size_t chunk = findChunk( object );
+		return chunk * m_chunkSize + ( object - m_chunks[chunk] );
+	}
+
+	const std::size_t m_chunkSize;
+	const ChunkAllocator m_allocator;
+	std::vector<T*> m_chunks;
+	std::vector<std::pair<const T*, std::size_t>> m_chunksByAddress;
+	std::vector<std::uint64_t> m_live;
+	std::vector<std::size_t> m_free;
+	std::size_t m_highWater;
+	std::size_t m_size;
+	std::uint64_t m_generation;
+};
+
+// One Pool per shape type, all cleared together.
+//
+//	ShapePool<Rectangle, Circle> shapes;
+//	list.push_back( shapes.create<Rectangle>( 0,0,10,20 ) );
+//	...
+//	shapes.clear();
+template<typename... Types>
+class ShapePool {
+public:
+	explicit ShapePool( std::size_t chunkSize = 1024 )
+		: m_pools( settingsFor<Types>( PoolSettings( chunkSize ) )... )
+	{}
+
+	explicit ShapePool( const PoolSettings& settings )
+		: m_pools( settingsFor<Types>( settings )... )
+	{}
+
+	template<typename T>
+	Pool<T>& pool() {
+
+		return std::get<Pool<T>>( m_pools );
+	}
+
+	template<typename T, typename... Args>
+	T* create( Args&&... args ) {
+
+		return pool<T>().create( std::forward<Args>( args )... );
+	}
+
+	template<typename T>
+	void destroy( T* object ) {
+
+		pool<T>().destroy( object );
+	}
+
+	// every Rectangle, then every Circle, ... each in slot order
+	template<typename Fn>
+	void forEach( Fn fn ) {
+
+		( pool<Types>().forEach( fn ), ... );
+	}
+
+	std::size_t size() const {
+
+		return ( 0 + ... + std::get<Pool<Types>>( m_pools ).size() );
+	}
+
+	// changes whenever any of the pools' does; see TypeBatches::update
+	std::uint64_t generation() const {
+
+		return ( std::uint64_t( 0 ) + ... + std::get<Pool<Types>>( m_pools ).generation() );
+	}
+
+	void clear() {
+
+		( pool<Types>().clear(), ... );
+	}
+
+	// Packs the shapes the list points at into contiguous memory, one run
+	// per type, in order of where they used to be, and fixes up the list.
+	// The list keeps its order unless sortList is set, in which case it's
+	// sorted to match memory (by type, then address), so walking it goes
+	// straight through each pool.
+	//
+	// Every pointer into the pools other than the list's goes stale.
+	// Base has to sit at the start of each type (plain single inheritance).
+	template<typename Base>
+	void compact( std::vector<Base*>& list, bool sortList = false ) {
+
+		( compactPool<Types>( list ), ... );
+
+		if ( sortList ) {
+
+			std::vector<std::pair<std::size_t, Base*>> ranked( list.size() );
+			for ( std::size_t i = 0; i < list.size(); ++i ) {
+				ranked[i] = std::make_pair( rankOf( list[i] ), list[i] );
+			}
+
+			std::sort( ranked.begin(), ranked.end() );
+			for ( std::size_t i = 0; i < list.size(); ++i ) {
+				list[i] = ranked[i].second;
+			}
+		}
+	}
+
+private:
+	template<typename T, typename Base>
+	void compactPool( std::vector<Base*>& list ) {
+
+		Pool<T>& p = pool<T>();
+
+		std::vector<T*> order;
+		for ( std::size_t i = 0; i < list.size(); ++i ) {
+			if ( p.owns( list[i] ) ) {
+				order.push_back( static_cast<T*>( list[i] ) );
+			}
+		}
+
+		std::sort( order.begin(), order.end() );
+		order.erase( std::unique( order.begin(), order.end() ), order.end() );
+
+		const std::vector<T*> moved = p.relocate( order );
+		for ( std::size_t i = 0; i < list.size(); ++i ) {
+
+			typename std::vector<T*>::const_iterator old = std::lower_bound( order.begin(), order.end(), list[i],
+				[]( T* object, Base* target ) { return static_cast<const void*>( object ) < static_cast<const void*>( target ); } );
+
+			if ( old != order.end() && static_cast<const void*>( *old ) == static_cast<const void*>( list[i] ) ) {
+				list[i] = moved[old - order.begin()];
+			}
+		}
+	}
+
+	// which pool it's in, counting from the first type
+	template<typename Base>
+	std::size_t rankOf( Base* shape ) {
+
+		const bool owned[] = { pool<Types>().owns( shape )... };
+
+		std::size_t rank = 0;
+		while ( rank < sizeof...( Types ) && !owned[rank] ) {
+			++rank;
+		}
+		return rank;
+	}
+
+	// pools can't be moved, so the tuple builds each one from the settings
+	template<typename T>
+	static const PoolSettings& settingsFor( const PoolSettings& settings ) {
+
+		return settings;
+	}
+
+	std::tuple<Pool<Types>...> m_pools;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef SHAPE_STORE_H
+#define SHAPE_STORE_H
+
+#include <vector>
+#include <cstddef>
+
+#if defined( __AVX__ ) || defined( __SSE__ ) || defined( _M_X64 )
+#include <immintrin.h>
+#endif
+
+#if defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+// Column kernels.
+// Whichever of AVX, SSE or NEON the compiler was told about gets used,
+// with a plain loop to mop up the tail (and for everybody else).
+// The vector versions add up in a different order than the plain loop,
+// so the last few bits of a float sum can differ.
+namespace columns {
+
+	// sum of a[i] * b[i]
+	inline float sumOfProducts( const float* a, const float* b, std::size_t n ) {
+
+		std::size_t i = 0;
+		float total = 0;
+
+#if defined( __AVX__ )
+		__m256 acc = _mm256_setzero_ps();
+		for ( ; i + 8 <= n; i += 8 ) {
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_loadu_ps( a + i ), _mm256_loadu_ps( b + i ) ) );
+		}
+		__m128 half = _mm_add_ps( _mm256_castps256_ps128( acc ), _mm256_extractf128_ps( acc, 1 ) );
+		half = _mm_add_ps( half, _mm_movehl_ps( half, half ) );
+		half = _mm_add_ss( half, _mm_shuffle_ps( half, half, 1 ) );
+		total = _mm_cvtss_f32( half );
+#elif defined( __SSE__ ) || defined( _M_X64 )
+		__m128 acc = _mm_setzero_ps();
+		for ( ; i + 4 <= n; i += 4 ) {
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_loadu_ps( a + i ), _mm_loadu_ps( b + i ) ) );
+		}
+		acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+		acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+		total = _mm_cvtss_f32( acc );
+#elif defined( __ARM_NEON )
+		float32x4_t acc = vdupq_n_f32( 0 );
+		for ( ; i + 4 <= n; i += 4 ) {
+			acc = vmlaq_f32( acc, vld1q_f32( a + i ), vld1q_f32( b + i ) );
+		}
+		float32x2_t pair = vadd_f32( vget_low_f32( acc ), vget_high_f32( acc ) );
+		total = vget_lane_f32( vpadd_f32( pair, pair ), 0 );
+#endif
+
+		for ( ; i < n; ++i ) {
+			total += a[i] * b[i];
+		}
+
+		return total;
+	}
+
+	// out[i] = scale * a[i] * b[i]
+	inline void scaledProducts( const float* a, const float* b, float scale, float* out, std::size_t n ) {
+
+		std::size_t i = 0;
+
+#if defined( __AVX__ )
+		const __m256 s = _mm256_set1_ps( scale );
+		for ( ; i + 8 <= n; i += 8 ) {
+			_mm256_storeu_ps( out + i, _mm256_mul_ps( s, _mm256_mul_ps( _mm256_loadu_ps( a + i ), _mm256_loadu_ps( b + i ) ) ) );
+		}
+#elif defined( __SSE__ ) || defined( _M_X64 )
+		const __m128 s = _mm_set1_ps( scale );
+		for ( ; i + 4 <= n; i += 4 ) {
+			_mm_storeu_ps( out + i, _mm_mul_ps( s, _mm_mul_ps( _mm_loadu_ps( a + i ), _mm_loadu_ps( b + i ) ) ) );
+		}
+#elif defined( __ARM_NEON )
+		const float32x4_t s = vdupq_n_f32( scale );
+		for ( ; i + 4 <= n; i += 4 ) {
+			vst1q_f32( out + i, vmulq_f32( s, vmulq_f32( vld1q_f32( a + i ), vld1q_f32( b + i ) ) ) );
+		}
+#endif
+
+		for ( ; i < n; ++i ) {
+			out[i] = scale * a[i] * b[i];
+		}
+	}
+}
+
+// Structure-of-arrays storage for the three shapes.
+// Instead of a heap object per shape, every field gets its own column,
+// so a kernel that only needs w and h only ever touches w and h.
+//
+// Indices are per type. Removing swaps the last one of that type into
+// the hole, so don't hang on to indices across a remove.
+class ShapeStore {
+public:
+	struct RectangleColumns {
+		std::vector<float> x, y, w, h;
+		std::size_t size() const { return x.size(); }
+	};
+
+	struct CircleColumns {
+		std::vector<float> x, y, r;
+		std::size_t size() const { return x.size(); }
+	};
+
+	struct TriangleColumns {
+		std::vector<float> x, y, b, h;
+		std::size_t size() const { return x.size(); }
+	};
+
+	// The column visitor: one visit per shape type, with the whole column.
+	class Visitor {
+	public:
+		virtual ~Visitor() {}
+		virtual void visit( const RectangleColumns& rectangles ) {}
+		virtual void visit( const CircleColumns& circles ) {}
+		virtual void visit( const TriangleColumns& triangles ) {}
+	};
+
+	std::size_t addRectangle( float x, float y, float w, float h ) {
+
+		m_rectangles.x.push_back( x ); m_rectangles.y.push_back( y );
+		m_rectangles.w.push_back( w ); m_rectangles.h.push_back( h );
+		return m_rectangles.size() - 1;
+	}
+
+	std::size_t addCircle( float x, float y, float r ) {
+
+		m_circles.x.push_back( x ); m_circles.y.push_back( y );
+		m_circles.r.push_back( r );
+		return m_circles.size() - 1;
+	}
+
+	std::size_t addTriangle( float x, float y, float b, float h ) {
+
+		m_triangles.x.push_back( x ); m_triangles.y.push_back( y );
+		m_triangles.b.push_back( b ); m_triangles.h.push_back( h );
+		return m_triangles.size() - 1;
+	}
+
+	void removeRectangle( std::size_t i ) {
+
+		swapRemove( m_rectangles.x, i ); swapRemove( m_rectangles.y, i );
+		swapRemove( m_rectangles.w, i ); swapRemove( m_rectangles.h, i );
+	}
+
+	void removeCircle( std::size_t i ) {
+
+		swapRemove( m_circles.x, i ); swapRemove( m_circles.y, i );
+		swapRemove( m_circles.r, i );
+	}
+
+	void removeTriangle( std::size_t i ) {
+
+		swapRemove( m_triangles.x, i ); swapRemove( m_triangles.y, i );
+		swapRemove( m_triangles.b, i ); swapRemove( m_triangles.h, i );
+	}
+
+	const RectangleColumns& rectangles() const { return m_rectangles; }
+	const CircleColumns& circles() const { return m_circles; }
+	const TriangleColumns& triangles() const { return m_triangles; }
+
+	std::size_t size() const {
+
+		return m_rectangles.size() + m_circles.size() + m_triangles.size();
+	}
+
+	void clear() {
+
+		m_rectangles = RectangleColumns();
+		m_circles = CircleColumns();
+		m_triangles = TriangleColumns();
+	}
+
+	// Three virtual calls, no matter how many shapes.
+	void accept( Visitor* visitor ) const {
+
+		visitor->visit( m_rectangles );
+		visitor->visit( m_circles );
+		visitor->visit( m_triangles );
+	}
+
+private:
+	static void swapRemove( std::vector<float>& column, std::size_t i ) {
+
+		column[i] = column.back();
+		column.pop_back();
+	}
+
+	RectangleColumns m_rectangles;
+	CircleColumns m_circles;
+	TriangleColumns m_triangles;
+};
+
+#endif
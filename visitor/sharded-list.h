@@ -0,0 +1,532 @@
+#ifndef SHARDED_LIST_H
+#define SHARDED_LIST_H
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <exception>
+#include <algorithm>
+#include <utility>
+#include <new>
+#include <cstddef>
+
+// Build with -DUSE_LIBNUMA and link -lnuma to get the real thing.
+// Without it there's one node, chunks come from the heap,
+// and worker threads go wherever the scheduler puts them.
+#if defined( USE_LIBNUMA )
+#include <numa.h>
+#endif
+
+#include "shape-pool.h"
+
+// The few NUMA things the sharded list needs.
+namespace numa {
+
+	// libnuma fills in its table of each node's CPUs the first time it's
+	// asked, and not thread-safely, so nodes() asks before any pinned
+	// thread starts.
+	inline bool hasUsableCPUs( unsigned node ) {
+
+#if defined( USE_LIBNUMA )
+		struct bitmask* cpus = numa_allocate_cpumask();
+		bool usable = false;
+		if ( numa_node_to_cpus( int( node ), cpus ) == 0 ) {
+
+			for ( unsigned cpu = 0; cpu < cpus->size && !usable; ++cpu ) {
+				usable = numa_bitmask_isbitset( cpus, cpu ) && numa_bitmask_isbitset( numa_all_cpus_ptr, cpu );
+			}
+		}
+		numa_free_cpumask( cpus );
+		return usable;
+#else
+		(void)node;
+		return false;
+#endif
+	}
+
+	// The nodes worth putting a shard on: ones we're allowed to take memory
+	// from and that have CPUs we're allowed to run on. Node numbers can have
+	// holes in them, and some nodes are memory with no CPUs (or the other
+	// way round), so this isn't just 0 up to numa_max_node().
+	inline std::vector<unsigned> nodes() {
+
+#if defined( USE_LIBNUMA )
+		if ( numa_available() >= 0 ) {
+
+			std::vector<unsigned> usable;
+			for ( int node = 0; node <= numa_max_node(); ++node ) {
+
+				if ( numa_bitmask_isbitset( numa_all_nodes_ptr, unsigned( node ) ) && hasUsableCPUs( unsigned( node ) ) ) {
+					usable.push_back( unsigned( node ) );
+				}
+			}
+
+			// nothing fits both, so everything goes on the one we'd get anyway
+			if ( usable.empty() ) {
+				usable.push_back( unsigned( numa_preferred() ) );
+			}
+			return usable;
+		}
+#endif
+		return std::vector<unsigned>( 1, 0 );
+	}
+
+	inline unsigned nodeCount() {
+
+		return unsigned( nodes().size() );
+	}
+
+	// Keeps the calling thread on the node's CPUs. False if it couldn't.
+	inline bool pinToNode( unsigned node ) {
+
+#if defined( USE_LIBNUMA )
+		if ( numa_available() >= 0 ) {
+			return numa_run_on_node( int( node ) ) == 0;
+		}
+#endif
+		(void)node;
+		return false;
+	}
+
+	inline void* allocateOnNode( std::size_t bytes, std::size_t alignment, void* context ) {
+
+#if defined( USE_LIBNUMA )
+		// numa_alloc_onnode hands out whole pages, which is plenty of alignment
+		if ( numa_available() >= 0 && alignment <= 4096 ) {
+
+			void* chunk = numa_alloc_onnode( bytes, int( reinterpret_cast<std::size_t>( context ) ) );
+			if ( !chunk ) {
+				throw std::bad_alloc();
+			}
+			return chunk;
+		}
+#endif
+		(void)context;
+		return ::operator new( bytes, std::align_val_t( alignment ) );
+	}
+
+	inline void releaseOnNode( void* chunk, std::size_t bytes, std::size_t alignment, void* context ) {
+
+#if defined( USE_LIBNUMA )
+		if ( numa_available() >= 0 && alignment <= 4096 ) {
+
+			numa_free( chunk, bytes );
+			return;
+		}
+#endif
+		(void)bytes;
+		(void)context;
+		::operator delete( chunk, std::align_val_t( alignment ) );
+	}
+
+	// pool chunks that live on the node
+	inline ChunkAllocator allocatorFor( unsigned node ) {
+
+		return ChunkAllocator( &allocateOnNode, &releaseOnNode, reinterpret_cast<void*>( std::size_t( node ) ) );
+	}
+
+	// The same thing for containers, so a shard's list lives on its node
+	// too, not wherever the thread that first grew it was running.
+	// Lists grow by doubling, so whole pages per allocation don't add up to much.
+	template<typename T>
+	struct NodeAllocator {
+		typedef T value_type;
+
+		unsigned node;
+
+		explicit NodeAllocator( unsigned node ) : node( node ) {}
+
+		template<typename U>
+		NodeAllocator( const NodeAllocator<U>& other ) : node( other.node ) {}
+
+		T* allocate( std::size_t count ) {
+
+			return static_cast<T*>( allocateOnNode( count * sizeof( T ), alignof( T ), context() ) );
+		}
+
+		void deallocate( T* pointer, std::size_t count ) {
+
+			releaseOnNode( pointer, count * sizeof( T ), alignof( T ), context() );
+		}
+
+		template<typename U>
+		bool operator==( const NodeAllocator<U>& other ) const { return node == other.node; }
+
+		template<typename U>
+		bool operator!=( const NodeAllocator<U>& other ) const { return node != other.node; }
+
+	private:
+		void* context() const {
+
+			return reinterpret_cast<void*>( std::size_t( node ) );
+		}
+	};
+}
+
+// A ShapeList cut into shards, each one living on a NUMA node.
+//
+// Every shard has its own ShapePool, whose chunks are allocated on the
+// shard's node, and its own worker thread, pinned to that node (pinned()
+// says whether that worked). Only nodes with both memory and CPUs we're
+// allowed to use get shards. Visiting runs every shard at once, each on
+// its own thread, with its own visitor from factory(); nobody reads
+// another node's memory. Then the shards'
+// visitors are folded together with reduce( into, from ), in shard order,
+// same as for_each_accept in parallel-visit.h.
+//
+// New shapes go to the smallest shard. Destroying them can leave shards
+// lopsided over time, which rebalance() evens out by moving shapes from
+// the big shards to the small ones. Moving means copying into the other
+// node's pool, so, like ShapePool::compact, it's for between frames:
+// onMove( from, to ) gets told about every shape that moved.
+//
+// Base has to sit at the start of each type (plain single inheritance),
+// and the types have to be move-constructible.
+template<typename Base, typename... Types>
+class ShardedShapeList {
+public:
+	typedef std::vector<Base*, numa::NodeAllocator<Base*>> ShardList;
+
+	// shardsPerNode > 1 gives a node more than one thread to visit with
+	explicit ShardedShapeList( unsigned shardsPerNode = 1, std::size_t chunkSize = 1024 ) {
+
+		const std::vector<unsigned> nodes = numa::nodes();
+		for ( std::size_t n = 0; n < nodes.size(); ++n ) {
+
+			for ( unsigned s = 0; s < std::max( 1u, shardsPerNode ); ++s ) {
+				m_shards.emplace_back( new Shard( nodes[n], chunkSize ) );
+			}
+		}
+	}
+
+	~ShardedShapeList() {
+
+		clear();
+	}
+
+	ShardedShapeList( const ShardedShapeList& ) = delete;
+	ShardedShapeList& operator=( const ShardedShapeList& ) = delete;
+
+	template<typename T, typename... Args>
+	T* create( Args&&... args ) {
+
+		std::size_t smallest = 0;
+		for ( std::size_t i = 1; i < m_shards.size(); ++i ) {
+			if ( m_shards[i]->list.size() < m_shards[smallest]->list.size() ) {
+				smallest = i;
+			}
+		}
+
+		return createIn<T>( smallest, std::forward<Args>( args )... );
+	}
+
+	// put it on a particular shard, for when you know better
+	template<typename T, typename... Args>
+	T* createIn( std::size_t shard, Args&&... args ) {
+
+		Shard& target = *m_shards[shard];
+		T* shape = target.pools.template create<T>( std::forward<Args>( args )... );
+
+		m_locations[shape] = Location( shard, target.list.size() );
+		target.list.push_back( shape );
+		return shape;
+	}
+
+	void destroy( Base* shape ) {
+
+		const Location location = forget( shape );
+		ShapePool<Types...>& pools = m_shards[location.first]->pools;
+
+		bool destroyed = false;
+		( ( destroyed = destroyed || destroyIfA<Types>( pools, shape ) ), ... );
+	}
+
+	void clear() {
+
+		for ( std::size_t i = 0; i < m_shards.size(); ++i ) {
+
+			m_shards[i]->list.clear();
+			m_shards[i]->pools.clear();
+		}
+		m_locations.clear();
+	}
+
+	std::size_t size() const {
+
+		return m_locations.size();
+	}
+
+	std::size_t shardCount() const {
+
+		return m_shards.size();
+	}
+
+	unsigned nodeOf( std::size_t shard ) const {
+
+		return m_shards[shard]->node;
+	}
+
+	// Whether the shard's worker really is running on its node's CPUs.
+	// Always false without libnuma. Otherwise it's false if the kernel said
+	// no, and the shard still works, its memory's just further away.
+	bool pinned( std::size_t shard ) const {
+
+		return m_shards[shard]->worker.pinned();
+	}
+
+	const ShardList& shard( std::size_t shard ) const {
+
+		return m_shards[shard]->list;
+	}
+
+	// Every shard visits its own shapes on its own node, all at once,
+	// then the visitors are reduced into one.
+	template<typename Factory, typename Reduce>
+	auto for_each_accept( Factory factory, Reduce reduce ) -> decltype( factory() ) {
+
+		typedef decltype( factory() ) VisitorType;
+
+		std::vector<std::optional<VisitorType>> visitors( m_shards.size() );
+		for ( std::size_t i = 0; i < m_shards.size(); ++i ) {
+
+			Shard& shard = *m_shards[i];
+			std::optional<VisitorType>& visitor = visitors[i];
+
+			shard.worker.start( [&shard, &visitor, &factory] {
+
+				visitor.emplace( factory() );
+				for ( std::size_t s = 0; s < shard.list.size(); ++s ) {
+					shard.list[s]->accept( &*visitor );
+				}
+			} );
+		}
+
+		std::exception_ptr error;
+		for ( std::size_t i = 0; i < m_shards.size(); ++i ) {
+
+			std::exception_ptr shardError = m_shards[i]->worker.wait();
+			if ( shardError && !error ) {
+				error = shardError;
+			}
+		}
+		if ( error ) {
+			std::rethrow_exception( error );
+		}
+
+		VisitorType result( std::move( *visitors[0] ) );
+		for ( std::size_t i = 1; i < visitors.size(); ++i ) {
+			reduce( result, *visitors[i] );
+		}
+		return result;
+	}
+
+	// Evens the shards out until none is more than tolerance (as a fraction)
+	// off the average. Returns how many shapes moved.
+	std::size_t rebalance( double tolerance = 0.1, std::function<void( Base* from, Base* to )> onMove = nullptr ) {
+
+		const std::size_t average = size() / m_shards.size();
+		const std::size_t slack = std::max<std::size_t>( 1, std::size_t( double( average ) * tolerance ) );
+		std::size_t moved = 0;
+
+		for ( ;; ) {
+
+			std::size_t biggest = 0, smallest = 0;
+			for ( std::size_t i = 1; i < m_shards.size(); ++i ) {
+
+				if ( m_shards[i]->list.size() > m_shards[biggest]->list.size() ) biggest = i;
+				if ( m_shards[i]->list.size() < m_shards[smallest]->list.size() ) smallest = i;
+			}
+
+			const std::size_t most = m_shards[biggest]->list.size();
+			const std::size_t least = m_shards[smallest]->list.size();
+			if ( most <= average + slack && least + slack >= average ) {
+				break;
+			}
+
+			// take the big one down to the average, or as far as the small one can go up
+			std::size_t count = std::min( most - average, average - std::min( least, average ) );
+			count = std::max<std::size_t>( count, 1 );
+
+			for ( std::size_t i = 0; i < count; ++i ) {
+
+				Base* from = m_shards[biggest]->list.back();
+				Base* to = move( from, biggest, smallest );
+				if ( onMove ) {
+					onMove( from, to );
+				}
+			}
+			moved += count;
+		}
+
+		return moved;
+	}
+
+private:
+	typedef std::pair<std::size_t, std::size_t> Location;	// shard, index in its list
+
+	// One thread, pinned to its node, doing one job at a time.
+	class Worker {
+	public:
+		// waits for the thread to have a go at pinning itself, so pinned() is settled
+		explicit Worker( unsigned node )
+			: m_hasJob( false ), m_stop( false ), m_started( false ), m_pinned( false ), m_thread( [this, node] { loop( node ); } ) {
+
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_wake.wait( lock, [this] { return m_started; } );
+		}
+
+		~Worker() {
+
+			{
+				std::lock_guard<std::mutex> lock( m_mutex );
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			m_thread.join();
+		}
+
+		void start( std::function<void()> job ) {
+
+			{
+				std::lock_guard<std::mutex> lock( m_mutex );
+				m_job = std::move( job );
+				m_error = nullptr;
+				m_hasJob = true;
+			}
+			m_wake.notify_all();
+		}
+
+		std::exception_ptr wait() {
+
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_wake.wait( lock, [this] { return !m_hasJob; } );
+			return m_error;
+		}
+
+		bool pinned() const {
+
+			return m_pinned;
+		}
+
+	private:
+		void loop( unsigned node ) {
+
+			const bool pinned = numa::pinToNode( node );
+			{
+				std::lock_guard<std::mutex> lock( m_mutex );
+				m_pinned = pinned;
+				m_started = true;
+			}
+			m_wake.notify_all();
+
+			for ( ;; ) {
+
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock( m_mutex );
+					m_wake.wait( lock, [this] { return m_stop || m_hasJob; } );
+					if ( m_stop && !m_hasJob ) {
+						return;
+					}
+					job = std::move( m_job );
+				}
+
+				std::exception_ptr error;
+				try {
+					job();
+				}
+				catch ( ... ) {
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock( m_mutex );
+					m_error = error;
+					m_hasJob = false;
+				}
+				m_wake.notify_all();
+			}
+		}
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::function<void()> m_job;
+		std::exception_ptr m_error;
+		bool m_hasJob;
+		bool m_stop;
+		bool m_started;
+		bool m_pinned;
+		std::thread m_thread;
+	};
+
+	struct Shard {
+		const unsigned node;
+		ShapePool<Types...> pools;
+		ShardList list;
+		Worker worker;
+
+		Shard( unsigned node, std::size_t chunkSize )
+			: node( node ), pools( PoolSettings( chunkSize, numa::allocatorFor( node ) ) ),
+			list( numa::NodeAllocator<Base*>( node ) ), worker( node ) {}
+	};
+
+	// takes it out of its shard's list, swapping the last one into the hole
+	Location forget( Base* shape ) {
+
+		typename std::unordered_map<Base*, Location>::iterator found = m_locations.find( shape );
+		const Location location = found->second;
+		m_locations.erase( found );
+
+		ShardList& list = m_shards[location.first]->list;
+		if ( location.second + 1 != list.size() ) {
+
+			list[location.second] = list.back();
+			m_locations[list[location.second]].second = location.second;
+		}
+		list.pop_back();
+		return location;
+	}
+
+	Base* move( Base* shape, std::size_t from, std::size_t to ) {
+
+		Base* moved = nullptr;
+		( ( moved = moved ? moved : moveIfA<Types>( shape, from, to ) ), ... );
+		return moved;
+	}
+
+	template<typename T>
+	static bool destroyIfA( ShapePool<Types...>& pools, Base* shape ) {
+
+		if ( !pools.template pool<T>().owns( shape ) ) {
+			return false;
+		}
+
+		pools.destroy( static_cast<T*>( shape ) );
+		return true;
+	}
+
+	template<typename T>
+	Base* moveIfA( Base* shape, std::size_t from, std::size_t to ) {
+
+		Pool<T>& source = m_shards[from]->pools.template pool<T>();
+		if ( !source.owns( shape ) ) {
+			return nullptr;
+		}
+
+		T* object = static_cast<T*>( shape );
+		T* moved = createIn<T>( to, std::move( *object ) );
+		forget( shape );
+		source.destroy( object );
+		return moved;
+	}
+
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	std::unordered_map<Base*, Location> m_locations;
+};
+
+#endif
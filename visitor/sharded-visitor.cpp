@@ -0,0 +1,136 @@
+//
+//		The Sharded Visitor
+//
+//	On a big server with two (or more) CPU sockets, each socket
+//	has its own memory. A thread can read the other socket's
+//	memory, but it's slower. One big ShapeList means, on average,
+//	half the shapes are on the wrong side for whoever visits them.
+//
+//	So cut the list up. Each piece (a shard) lives on one socket
+//	(a NUMA node), its shapes are allocated in that node's memory,
+//	and it's visited by a thread that's stuck to that node. After
+//	that it's the parallel visitor again: every shard gets its own
+//	RectangleCounter, and the counts get added up at the end.
+//
+//	Shards drift apart in size as shapes come and go, so every so
+//	often they get rebalanced.
+//
+//	For actual NUMA, build with -DUSE_LIBNUMA and -lnuma.
+//	Without it, it all still works, just on one node.
+//
+//	The machinery lives in sharded-list.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "sharded-list.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Visitor;
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* visitor ) = 0;
+};
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+// The same old RectangleCounter.
+class RectangleCounter : public Visitor {
+public:
+	float count;
+	RectangleCounter() : count(0) {}
+
+	void visit(Circle* circle) {}
+	void visit(Rectangle* rectangle) { ++count; }
+};
+
+class AreaCalculator : public Visitor {
+public:
+	double total;
+	AreaCalculator() : total(0) {}
+
+	void visit( Rectangle* rectangle ) { total += rectangle->w * rectangle->h; }
+	void visit( Circle* circle ) { total += PI * circle->r * circle->r; }
+};
+
+int main() {
+
+	// two shards a node, so even a one-node machine has something to shard
+	ShardedShapeList<Shape, Rectangle, Circle> shapes( 2 );
+	cout << shapes.shardCount() << " shards over " << numa::nodeCount() << " node(s)" << endl;
+	size_t pinned = 0;
+	for ( size_t i = 0; i < shapes.shardCount(); ++i ) {
+		pinned += shapes.pinned( i );
+	}
+	cout << pinned << " of them pinned to their node" << endl;
+
+	for ( int i = 0; i < 300000; ++i ) {
+
+		if ( i % 3 == 0 ) shapes.create<Circle>( i, i, 1 );
+		else shapes.create<Rectangle>( i, i, 2, 3 );
+	}
+
+	RectangleCounter rc = shapes.for_each_accept(
+		[] { return RectangleCounter(); },
+		[]( RectangleCounter& into, const RectangleCounter& from ) { into.count += from.count; } );
+	cout << "there are " << rc.count << " rectangles" << endl;
+	assert( rc.count == 200000 );
+
+	// half the first shard goes away, so it ends up short
+	size_t destroyed = 0;
+	vector<Shape*> firstShard( shapes.shard( 0 ).begin(), shapes.shard( 0 ).end() );
+	for ( size_t i = 0; i < firstShard.size(); i += 2 ) {
+
+		shapes.destroy( firstShard[i] );
+		++destroyed;
+	}
+
+	for ( size_t i = 0; i < shapes.shardCount(); ++i ) {
+		cout << "shard " << i << " (node " << shapes.nodeOf( i ) << "): " << shapes.shard( i ).size() << " shapes" << endl;
+	}
+
+	const size_t moved = shapes.rebalance();
+	cout << "rebalancing moved " << moved << " shapes" << endl;
+	for ( size_t i = 0; i < shapes.shardCount(); ++i ) {
+		cout << "shard " << i << " (node " << shapes.nodeOf( i ) << "): " << shapes.shard( i ).size() << " shapes" << endl;
+	}
+
+	AreaCalculator ac = shapes.for_each_accept(
+		[] { return AreaCalculator(); },
+		[]( AreaCalculator& into, const AreaCalculator& from ) { into.total += from.total; } );
+	cout << "total area is: " << ac.total << " with " << shapes.size() << " shapes left" << endl;
+	assert( shapes.size() == 300000 - destroyed );
+
+	return 0;
+}
@@ -0,0 +1,455 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP 1
+#endif
+
+#include "../rtti/rtti.h"
+
+// A scene on disk that can be visited without loading it.
+//
+// The file is a header, then blocks of columns, then a table of the
+// blocks. A block is up to a few thousand shapes of one type, stored as
+// structure-of-arrays: every float field gets its own column of floats.
+// Types are tagged by RTTI name hash, so a reader finds out what a block
+// holds with RTTIRegistry::findByHash and nothing else.
+//
+//	header		magic, byte order mark, block count, table offset, file size
+//	blocks		fieldCount columns per block, each 64-byte aligned
+//	table		nameHash, fieldCount, count, offset, column stride per block
+//
+// Numbers are in the writer's byte order. A reader on a machine that
+// disagrees just refuses the file.
+
+namespace snapshot_format {
+
+	static const char MAGIC[8] = { 'S', 'H', 'P', 'S', 'N', 'A', 'P', '1' };
+	static const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+	static const std::size_t ALIGNMENT = 64;
+
+	struct Header {
+		char magic[8];
+		std::uint32_t byteOrder;
+		std::uint32_t blockCount;
+		std::uint64_t tableOffset;
+		std::uint64_t fileSize;
+		char padding[32];
+	};
+
+	struct BlockEntry {
+		std::uint32_t nameHash;
+		std::uint32_t fieldCount;
+		std::uint64_t count;
+		std::uint64_t offset;
+		std::uint64_t columnStride;
+	};
+
+	inline std::uint64_t aligned( std::uint64_t offset ) {
+
+		return ( offset + ALIGNMENT - 1 ) & ~std::uint64_t( ALIGNMENT - 1 );
+	}
+}
+
+// Writes a snapshot a shape at a time.
+//
+// Each type gets a block's worth of buffer. When it fills, the block goes
+// out to the file and the buffer starts over, so dumping a huge scene only
+// ever holds rowsPerBlock shapes per type, not a second copy of the scene.
+// The table and header go out in finish() (or the destructor).
+//
+// Every shape of a type must have the same number of fields, and at
+// least one; otherwise the write is dropped and good() goes false.
+class SnapshotWriter {
+public:
+	explicit SnapshotWriter( const char* path, std::size_t rowsPerBlock = 4096 )
+		: m_file( std::fopen( path, "wb" ) ), m_rowsPerBlock( rowsPerBlock ? rowsPerBlock : 1 ), m_offset( 0 ), m_good( m_file != nullptr ) {
+
+		// the real header goes in when we know where the table is
+		snapshot_format::Header blank;
+		std::memset( &blank, 0, sizeof( blank ) );
+		put( &blank, sizeof( blank ) );
+	}
+
+	~SnapshotWriter() {
+
+		finish();
+	}
+
+	SnapshotWriter( const SnapshotWriter& ) = delete;
+	SnapshotWriter& operator=( const SnapshotWriter& ) = delete;
+
+	// false once anything has gone wrong
+	bool good() const {
+
+		return m_good;
+	}
+
+	// one shape of a type
+	void write( const RTTI& type, const float* fields, unsigned fieldCount ) {
+
+		write( type.getNameHash(), fields, fieldCount );
+	}
+
+	void write( std::uint32_t nameHash, const float* fields, unsigned fieldCount ) {
+
+		if ( !m_file ) {
+			return;
+		}
+
+		// a shape with nothing in it has no column to count its rows in
+		if ( fieldCount == 0 ) {
+
+			m_good = false;
+			return;
+		}
+
+		Pending& pending = m_pending[nameHash];
+		if ( pending.columns.empty() ) {
+
+			pending.columns.resize( fieldCount );
+			for ( unsigned f = 0; f < fieldCount; ++f ) {
+				pending.columns[f].reserve( m_rowsPerBlock );
+			}
+		}
+		else if ( pending.columns.size() != fieldCount ) {
+
+			m_good = false;
+			return;
+		}
+
+		for ( unsigned f = 0; f < fieldCount; ++f ) {
+			pending.columns[f].push_back( fields[f] );
+		}
+
+		if ( pending.columns[0].size() == m_rowsPerBlock ) {
+			flushBlock( nameHash, pending );
+		}
+	}
+
+	// everything left, then the table, then the header; true if it all made it
+	bool finish() {
+
+		if ( !m_file ) {
+			return m_good;
+		}
+
+		for ( std::unordered_map<std::uint32_t, Pending>::iterator i = m_pending.begin(); i != m_pending.end(); ++i ) {
+			flushBlock( i->first, i->second );
+		}
+
+		pad();
+		snapshot_format::Header header;
+		std::memset( &header, 0, sizeof( header ) );
+		std::memcpy( header.magic, snapshot_format::MAGIC, sizeof( header.magic ) );
+		header.byteOrder = snapshot_format::BYTE_ORDER_MARK;
+		header.blockCount = std::uint32_t( m_blocks.size() );
+		header.tableOffset = m_offset;
+
+		if ( !m_blocks.empty() ) {
+			put( m_blocks.data(), m_blocks.size() * sizeof( snapshot_format::BlockEntry ) );
+		}
+		header.fileSize = m_offset;
+
+		if ( std::fseek( m_file, 0, SEEK_SET ) != 0 || std::fwrite( &header, sizeof( header ), 1, m_file ) != 1 ) {
+			m_good = false;
+		}
+		if ( std::fclose( m_file ) != 0 ) {
+			m_good = false;
+		}
+
+		m_file = nullptr;
+		m_pending.clear();
+		m_blocks.clear();
+		return m_good;
+	}
+
+private:
+	struct Pending {
+		std::vector<std::vector<float>> columns;
+	};
+
+	void flushBlock( std::uint32_t nameHash, Pending& pending ) {
+
+		if ( pending.columns.empty() || pending.columns[0].empty() ) {
+			return;
+		}
+
+		snapshot_format::BlockEntry entry;
+		entry.nameHash = nameHash;
+		entry.fieldCount = std::uint32_t( pending.columns.size() );
+		entry.count = pending.columns[0].size();
+		entry.columnStride = snapshot_format::aligned( entry.count * sizeof( float ) );
+
+		pad();
+		entry.offset = m_offset;
+		for ( std::size_t f = 0; f < pending.columns.size(); ++f ) {
+
+			put( pending.columns[f].data(), pending.columns[f].size() * sizeof( float ) );
+			pad();
+			pending.columns[f].clear();
+		}
+
+		m_blocks.push_back( entry );
+	}
+
+	void put( const void* data, std::size_t size ) {
+
+		if ( !m_file || std::fwrite( data, 1, size, m_file ) != size ) {
+			m_good = false;
+		}
+		m_offset += size;
+	}
+
+	void pad() {
+
+		static const char zeros[snapshot_format::ALIGNMENT] = {};
+		put( zeros, std::size_t( snapshot_format::aligned( m_offset ) - m_offset ) );
+	}
+
+	std::FILE* m_file;
+	const std::size_t m_rowsPerBlock;
+	std::uint64_t m_offset;
+	bool m_good;
+	std::unordered_map<std::uint32_t, Pending> m_pending;
+	std::vector<snapshot_format::BlockEntry> m_blocks;
+};
+
+// A snapshot file, mapped into memory and visited where it lies.
+//
+// Opening checks the header and table and that's it: no parsing, no
+// objects, no copies. The columns handed to visitors point straight into
+// the mapping, so the OS only pages in the parts somebody actually reads.
+// Without mmap it falls back to reading the file into one buffer.
+//
+// Columns are only good while the Snapshot is open.
+class Snapshot {
+public:
+	// One block: size shapes of one type, a column per field.
+	// type is null if nothing with that name hash is registered.
+	class Columns {
+	public:
+		std::uint32_t nameHash;
+		const RTTI* type;
+		std::size_t size;
+		unsigned fieldCount;
+
+		const float* field( unsigned i ) const {
+
+			return reinterpret_cast<const float*>( m_first + i * m_stride );
+		}
+
+	private:
+		friend class Snapshot;
+
+		const char* m_first;
+		std::size_t m_stride;
+	};
+
+	class Visitor {
+	public:
+		virtual ~Visitor() {}
+		virtual void visit( const Columns& columns ) = 0;
+	};
+
+	Snapshot() : m_data( nullptr ), m_size( 0 ), m_mapped( false ), m_blocks( nullptr ), m_blockCount( 0 ) {}
+
+	~Snapshot() {
+
+		close();
+	}
+
+	Snapshot( const Snapshot& ) = delete;
+	Snapshot& operator=( const Snapshot& ) = delete;
+
+	// false if the file's missing or isn't a snapshot we can read
+	bool open( const char* path ) {
+
+		close();
+		if ( !load( path ) ) {
+			return false;
+		}
+
+		if ( !validate() ) {
+
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+
+#if defined( SNAPSHOT_MMAP )
+		if ( m_mapped ) {
+			munmap( const_cast<char*>( m_data ), m_size );
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_mapped = false;
+		m_buffer.clear();
+		m_blocks = nullptr;
+		m_blockCount = 0;
+	}
+
+	bool isOpen() const {
+
+		return m_data != nullptr;
+	}
+
+	std::size_t blockCount() const {
+
+		return m_blockCount;
+	}
+
+	Columns block( std::size_t i ) const {
+
+		const snapshot_format::BlockEntry& entry = m_blocks[i];
+
+		Columns columns;
+		columns.nameHash = entry.nameHash;
+		columns.type = RTTIRegistry::findByHash( entry.nameHash );
+		columns.size = std::size_t( entry.count );
+		columns.fieldCount = entry.fieldCount;
+		columns.m_first = m_data + entry.offset;
+		columns.m_stride = std::size_t( entry.columnStride );
+		return columns;
+	}
+
+	// how many shapes of exactly this type
+	std::size_t count( const RTTI& type ) const {
+
+		std::size_t total = 0;
+		for ( std::size_t i = 0; i < m_blockCount; ++i ) {
+
+			if ( m_blocks[i].nameHash == type.getNameHash() ) {
+				total += std::size_t( m_blocks[i].count );
+			}
+		}
+		return total;
+	}
+
+	// One virtual call per block, not per shape.
+	void accept( Visitor* visitor ) const {
+
+		for ( std::size_t i = 0; i < m_blockCount; ++i ) {
+			visitor->visit( block( i ) );
+		}
+	}
+
+	template<typename Fn>
+	void forEach( Fn fn ) const {
+
+		for ( std::size_t i = 0; i < m_blockCount; ++i ) {
+			fn( block( i ) );
+		}
+	}
+
+private:
+	bool load( const char* path ) {
+
+#if defined( SNAPSHOT_MMAP )
+		const int fd = ::open( path, O_RDONLY );
+		if ( fd < 0 ) {
+			return false;
+		}
+
+		struct stat info;
+		if ( fstat( fd, &info ) != 0 || info.st_size <= 0 ) {
+
+			::close( fd );
+			return false;
+		}
+
+		void* mapping = mmap( nullptr, std::size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+		::close( fd );
+		if ( mapping == MAP_FAILED ) {
+			return false;
+		}
+
+		m_data = static_cast<const char*>( mapping );
+		m_size = std::size_t( info.st_size );
+		m_mapped = true;
+		return true;
+#else
+		std::FILE* file = std::fopen( path, "rb" );
+		if ( !file ) {
+			return false;
+		}
+
+		char chunk[65536];
+		std::size_t read;
+		while ( ( read = std::fread( chunk, 1, sizeof( chunk ), file ) ) > 0 ) {
+			m_buffer.insert( m_buffer.end(), chunk, chunk + read );
+		}
+		std::fclose( file );
+
+		if ( m_buffer.empty() ) {
+			return false;
+		}
+		m_data = m_buffer.data();
+		m_size = m_buffer.size();
+		return true;
+#endif
+	}
+
+	// everything the blocks point at has to be inside the file
+	bool validate() {
+
+		if ( m_size < sizeof( snapshot_format::Header ) ) {
+			return false;
+		}
+
+		snapshot_format::Header header;
+		std::memcpy( &header, m_data, sizeof( header ) );
+		if ( std::memcmp( header.magic, snapshot_format::MAGIC, sizeof( header.magic ) ) != 0
+		     || header.byteOrder != snapshot_format::BYTE_ORDER_MARK
+		     || header.fileSize != m_size
+		     || header.tableOffset % snapshot_format::ALIGNMENT != 0
+		     || header.tableOffset > m_size
+		     || ( m_size - header.tableOffset ) / sizeof( snapshot_format::BlockEntry ) < header.blockCount ) {
+			return false;
+		}
+
+		const snapshot_format::BlockEntry* blocks = reinterpret_cast<const snapshot_format::BlockEntry*>( m_data + header.tableOffset );
+		for ( std::uint32_t i = 0; i < header.blockCount; ++i ) {
+
+			// count is checked by dividing the stride, not multiplying it up,
+			// so a huge count can't wrap round to fit (and a zero stride
+			// only holds an empty column)
+			const snapshot_format::BlockEntry& entry = blocks[i];
+			if ( entry.offset % snapshot_format::ALIGNMENT != 0
+			     || entry.columnStride % snapshot_format::ALIGNMENT != 0
+			     || entry.count > entry.columnStride / sizeof( float )
+			     || entry.offset > header.tableOffset
+			     || ( entry.columnStride && entry.fieldCount > ( header.tableOffset - entry.offset ) / entry.columnStride ) ) {
+				return false;
+			}
+		}
+
+		m_blocks = blocks;
+		m_blockCount = header.blockCount;
+		return true;
+	}
+
+	const char* m_data;
+	std::size_t m_size;
+	bool m_mapped;
+	std::vector<char> m_buffer;
+	const snapshot_format::BlockEntry* m_blocks;
+	std::size_t m_blockCount;
+};
+
+#endif
@@ -0,0 +1,177 @@
+//
+//		The Column Visitor
+//
+//	Visiting a Shape at a time means following a pointer to
+//	somewhere on the heap, a virtual call to accept, and another
+//	virtual call to visit, just to multiply two floats together.
+//	The multiplying is the cheap part.
+//
+//	This one flips it around. The ShapeStore keeps every field of
+//	every shape type in its own tightly packed column (all the x's,
+//	then all the y's, and so on; "structure of arrays"), and the
+//	visitor visits a whole type's columns at once. Area is then
+//	a straight run through w[] and h[] that the SIMD units can chew
+//	through several shapes at a time.
+//
+//	Cold code that just wants the old pointer-based Visitor
+//	still gets one, further down.
+//
+//	The store and kernels live in shape-store.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "shape-store.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+// The column version of the AreaCalculator.
+// It works out every area of a type in one kernel call,
+// keeps them around, and keeps a running total.
+class ColumnAreaCalculator : public ShapeStore::Visitor {
+public:
+	vector<float> rectangleAreas, circleAreas, triangleAreas;
+	float total;
+	ColumnAreaCalculator() : total(0) {}
+
+	void visit( const ShapeStore::RectangleColumns& rectangles ) {
+
+		rectangleAreas.resize( rectangles.size() );
+		columns::scaledProducts( rectangles.w.data(), rectangles.h.data(), 1, rectangleAreas.data(), rectangles.size() );
+		total += columns::sumOfProducts( rectangles.w.data(), rectangles.h.data(), rectangles.size() );
+	}
+
+	void visit( const ShapeStore::CircleColumns& circles ) {
+
+		circleAreas.resize( circles.size() );
+		columns::scaledProducts( circles.r.data(), circles.r.data(), PI, circleAreas.data(), circles.size() );
+		total += PI * columns::sumOfProducts( circles.r.data(), circles.r.data(), circles.size() );
+	}
+
+	// Hey, it turns out it IS b*h/2.
+	void visit( const ShapeStore::TriangleColumns& triangles ) {
+
+		triangleAreas.resize( triangles.size() );
+		columns::scaledProducts( triangles.b.data(), triangles.h.data(), 0.5f, triangleAreas.data(), triangles.size() );
+		total += 0.5f * columns::sumOfProducts( triangles.b.data(), triangles.h.data(), triangles.size() );
+	}
+};
+
+// Counting rectangles is now just asking how long the column is.
+class ColumnRectangleCounter : public ShapeStore::Visitor {
+public:
+	float count;
+	ColumnRectangleCounter() : count(0) {}
+
+	void visit( const ShapeStore::RectangleColumns& rectangles ) { count += rectangles.size(); }
+};
+
+// And here's the old pointer-based way, for cold code
+// that doesn't care how fast it goes.
+class Visitor;
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* visitor ) = 0;
+};
+
+class Rectangle;
+class Circle;
+class Triangle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+	virtual void visit( Triangle* triangle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Triangle : public Shape {
+public:
+	float b, h;
+	Triangle( float x, float y, float b, float h ) : Shape(x,y), b(b), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Namer : public Visitor {
+public:
+	void visit( Rectangle* rectangle ) { cout << "name: " << "rectangle" << endl; }
+	void visit( Circle* circle ) { cout << "name: " << "circle" << endl; }
+	void visit( Triangle* triangle ) { cout << "name: " << "triangle" << endl; }
+};
+
+// The adapter. It builds a Shape on the stack out of each row
+// of the columns and lets it accept the Visitor like always.
+// Changes the visitor makes to the temporary shape don't stick,
+// so keep it to cold, read-only stuff.
+void acceptEach( const ShapeStore& store, Visitor* visitor ) {
+
+	const ShapeStore::RectangleColumns& rs = store.rectangles();
+	for ( size_t i = 0; i < rs.size(); ++i ) {
+		Rectangle rectangle( rs.x[i], rs.y[i], rs.w[i], rs.h[i] );
+		rectangle.accept( visitor );
+	}
+
+	const ShapeStore::CircleColumns& cs = store.circles();
+	for ( size_t i = 0; i < cs.size(); ++i ) {
+		Circle circle( cs.x[i], cs.y[i], cs.r[i] );
+		circle.accept( visitor );
+	}
+
+	const ShapeStore::TriangleColumns& ts = store.triangles();
+	for ( size_t i = 0; i < ts.size(); ++i ) {
+		Triangle triangle( ts.x[i], ts.y[i], ts.b[i], ts.h[i] );
+		triangle.accept( visitor );
+	}
+}
+
+int main() {
+
+	ShapeStore store;
+	store.addRectangle( 0,0,10,20 );
+	store.addRectangle( 10,10, 5,3 );
+	store.addCircle( 5,5, 15 );
+	store.addTriangle( 2,2, 4, 3.14 );
+
+	// areas, a column at a time
+	ColumnAreaCalculator ac;
+	store.accept( &ac );
+	for ( size_t i = 0; i < ac.rectangleAreas.size(); ++i )
+		cout << "rectangle area is: " << ac.rectangleAreas[i] << endl;
+	for ( size_t i = 0; i < ac.circleAreas.size(); ++i )
+		cout << "circle area is: " << ac.circleAreas[i] << endl;
+	for ( size_t i = 0; i < ac.triangleAreas.size(); ++i )
+		cout << "triangle area is: " << ac.triangleAreas[i] << endl;
+	cout << "total area is: " << ac.total << endl;
+
+	// name, the old-fashioned way
+	Namer n;
+	acceptEach( store, &n );
+
+	// counting
+	ColumnRectangleCounter rc;
+	store.accept( &rc );
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// An axis-aligned box.
+struct Bounds {
+	float minX, minY, maxX, maxY;
+
+	Bounds() : minX(0), minY(0), maxX(0), maxY(0) {}
+	Bounds( float minX, float minY, float maxX, float maxY ) : minX(minX), minY(minY), maxX(maxX), maxY(maxY) {}
+
+	bool overlaps( const Bounds& other ) const {
+
+		return minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+	}
+};
+
+// A uniform grid over a fixed patch of world, for "what's in here?".
+//
+// Every element goes in each cell its bounds touch, so a region query
+// only looks at elements in the cells the region touches. Anything
+// hanging off the edge of the world is kept in the edge cells, so
+// nothing gets lost, it just gets looked at more often.
+//
+// Pick a cell size around the size of a typical element: much smaller
+// and big elements sit in lots of cells, much bigger and every cell
+// is a crowd.
+//
+// Elements that move need update() with their new bounds.
+template<typename Base>
+class SpatialGrid {
+public:
+	SpatialGrid( const Bounds& world, float cellSize )
+		: m_world( world )
+		  , m_cellSize( cellSize )
+		  , m_columns( std::max( 1, int( std::ceil( ( world.maxX - world.minX ) / cellSize ) ) ) )
+		  , m_rows( std::max( 1, int( std::ceil( ( world.maxY - world.minY ) / cellSize ) ) ) )
+		  , m_cells( std::size_t( m_columns ) * m_rows )
+		  , m_stamp( 0 )
+	{}
+
+	void insert( Base* element, const Bounds& bounds ) {
+
+		if ( m_ids.count( element ) ) {
+			update( element, bounds );
+			return;
+		}
+
+		std::size_t id;
+		if ( !m_freeIds.empty() ) {
+			id = m_freeIds.back();
+			m_freeIds.pop_back();
+		}
+		else {
+			id = m_entries.size();
+			m_entries.push_back( Entry() );
+		}
+
+		m_entries[id] = Entry( element, bounds );
+		m_ids[element] = id;
+		forEachCell( bounds, [this, id]( std::vector<std::size_t>& cell ) { cell.push_back( id ); } );
+	}
+
+	void remove( Base* element ) {
+
+		typename std::unordered_map<Base*, std::size_t>::iterator found = m_ids.find( element );
+		if ( found == m_ids.end() ) {
+			return;
+		}
+
+		const std::size_t id = found->second;
+		forEachCell( m_entries[id].bounds, [id]( std::vector<std::size_t>& cell ) {
+			cell.erase( std::find( cell.begin(), cell.end(), id ) );
+		} );
+
+		m_entries[id] = Entry();
+		m_freeIds.push_back( id );
+		m_ids.erase( found );
+	}
+
+	void update( Base* element, const Bounds& bounds ) {
+
+		remove( element );
+		insert( element, bounds );
+	}
+
+	std::size_t size() const {
+
+		return m_ids.size();
+	}
+
+	// calls fn( element ) once for every element whose bounds overlap region
+	template<typename Fn>
+	void query( const Bounds& region, Fn fn ) {
+
+		// stamping beats a "seen" set for elements that span several cells
+		if ( ++m_stamp == 0 ) {
+
+			for ( std::size_t i = 0; i < m_entries.size(); ++i ) {
+				m_entries[i].stamp = 0;
+			}
+			m_stamp = 1;
+		}
+
+		forEachCell( region, [this, &region, &fn]( std::vector<std::size_t>& cell ) {
+
+			for ( std::size_t i = 0; i < cell.size(); ++i ) {
+
+				Entry& entry = m_entries[cell[i]];
+				if ( entry.stamp != m_stamp ) {
+
+					entry.stamp = m_stamp;
+					if ( entry.bounds.overlaps( region ) ) {
+						fn( entry.element );
+					}
+				}
+			}
+		} );
+	}
+
+	// the visitor version
+	template<typename VisitorType>
+	void accept_in_region( const Bounds& region, VisitorType* visitor ) {
+
+		query( region, [visitor]( Base* element ) { element->accept( visitor ); } );
+	}
+
+private:
+	struct Entry {
+		Entry() : element( nullptr ), stamp( 0 ) {}
+		Entry( Base* element, const Bounds& bounds ) : element( element ), bounds( bounds ), stamp( 0 ) {}
+
+		Base* element;
+		Bounds bounds;
+		unsigned stamp;
+	};
+
+	// Clamped while it's still a float: converting NaN, or anything past
+	// what an int holds, is undefined, so NaN lands in the first cell and
+	// the far-flung ones in the edge cells like everything else off the world.
+	static int cellIndex( float cell, int count ) {
+
+		if ( !( cell >= 0 ) ) {
+			return 0;
+		}
+		return cell < float( count - 1 ) ? int( cell ) : count - 1;
+	}
+
+	int column( float x ) const {
+
+		return cellIndex( std::floor( ( x - m_world.minX ) / m_cellSize ), m_columns );
+	}
+
+	int row( float y ) const {
+
+		return cellIndex( std::floor( ( y - m_world.minY ) / m_cellSize ), m_rows );
+	}
+
+	template<typename Fn>
+	void forEachCell( const Bounds& bounds, Fn fn ) {
+
+		const int firstColumn = column( bounds.minX ), lastColumn = column( bounds.maxX );
+		const int firstRow = row( bounds.minY ), lastRow = row( bounds.maxY );
+
+		for ( int r = firstRow; r <= lastRow; ++r ) {
+			for ( int c = firstColumn; c <= lastColumn; ++c ) {
+				fn( m_cells[std::size_t( r ) * m_columns + c] );
+			}
+		}
+	}
+
+	const Bounds m_world;
+	const float m_cellSize;
+	const int m_columns;
+	const int m_rows;
+	std::vector<std::vector<std::size_t>> m_cells;
+	std::vector<Entry> m_entries;
+	std::vector<std::size_t> m_freeIds;
+	std::unordered_map<Base*, std::size_t> m_ids;
+	unsigned m_stamp;
+};
+
+#endif
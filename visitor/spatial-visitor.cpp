@@ -0,0 +1,168 @@
+//
+//			Visiting Only What's Nearby
+//
+//	Most of the time, a visitor doesn't want every shape in the
+//	world. It wants the ones on screen, or the ones near the
+//	explosion. Visiting all of them and throwing most away works,
+//	right up until the world gets big.
+//
+//	So the shapes also go in a grid. Each shape sits in whichever
+//	cells its bounding box covers, and a region query only looks in
+//	the cells the region covers. A shape spanning a few cells still
+//	only gets visited once.
+//
+//	Where do the bounding boxes come from? A visitor, naturally.
+//	Rectangles have w and h, circles have r, triangles have b and h,
+//	and the BoundsCalculator knows what to make of each.
+//
+//	The machinery lives in spatial-grid.h.
+
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cmath>
+
+#include "spatial-grid.h"
+
+using namespace std;
+
+class Rectangle;
+class Circle;
+class Triangle;
+
+// The regular old visitor.
+class Visitor {
+	public:
+		virtual ~Visitor() {}
+		virtual void visit( Rectangle* r ) = 0;
+		virtual void visit( Circle* c ) = 0;
+		virtual void visit( Triangle* t ) = 0;
+};
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* v ) = 0;
+};
+
+// x, y is the bottom left corner
+class Rectangle : public Shape {
+	public:
+		float w, h;
+		Rectangle( float x, float y, float w, float h ) : Shape(x, y), w(w), h(h) {}
+		void accept( Visitor* v ) { v->visit( this ); }
+};
+
+// x, y is the centre
+class Circle : public Shape {
+	public:
+		float r;
+		Circle( float x, float y, float r ) : Shape(x, y), r(r) {}
+		void accept( Visitor* v ) { v->visit( this ); }
+};
+
+// x, y is the left end of the base
+class Triangle : public Shape {
+	public:
+		float b, h;
+		Triangle( float x, float y, float b, float h ) : Shape(x, y), b(b), h(h) {}
+		void accept( Visitor* v ) { v->visit( this ); }
+};
+
+// The box around whatever it visited last.
+class BoundsCalculator : public Visitor {
+	public:
+		Bounds bounds;
+
+		void visit( Rectangle* r ) { bounds = Bounds( r->x, r->y, r->x + r->w, r->y + r->h ); }
+		void visit( Circle* c ) { bounds = Bounds( c->x - c->r, c->y - c->r, c->x + c->r, c->y + c->r ); }
+		void visit( Triangle* t ) { bounds = Bounds( t->x, t->y, t->x + t->b, t->y + t->h ); }
+};
+
+// Counts what it's shown, by type.
+class Census : public Visitor {
+	public:
+		int rectangles, circles, triangles;
+		Census() : rectangles(0), circles(0), triangles(0) {}
+
+		void visit( Rectangle* r ) { ++rectangles; }
+		void visit( Circle* c ) { ++circles; }
+		void visit( Triangle* t ) { ++triangles; }
+
+		int total() const { return rectangles + circles + triangles; }
+};
+
+Bounds boundsOf( Shape* shape ) {
+
+	BoundsCalculator calculator;
+	shape->accept( &calculator );
+	return calculator.bounds;
+}
+
+int main() {
+
+	vector<Shape*> shapes;
+	shapes.push_back( new Rectangle( 1, 1, 2, 2 ) );
+	shapes.push_back( new Circle( 5, 5, 1 ) );
+	shapes.push_back( new Triangle( 80, 80, 5, 5 ) );
+	shapes.push_back( new Rectangle( 0, 0, 100, 1 ) );		// spans a whole row of cells
+	shapes.push_back( new Circle( 150, 150, 3 ) );			// off the edge of the world
+
+	SpatialGrid<Shape> grid( Bounds( 0, 0, 100, 100 ), 10 );
+	for ( size_t i = 0; i < shapes.size(); ++i ) {
+		grid.insert( shapes[i], boundsOf( shapes[i] ) );
+	}
+
+	// the bottom left corner
+	Census corner;
+	grid.accept_in_region( Bounds( 0, 0, 10, 10 ), &corner );
+	cout << "bottom left: " << corner.rectangles << " rectangles, " << corner.circles << " circles, "
+	     << corner.triangles << " triangles" << endl;
+	assert( corner.rectangles == 2 && corner.circles == 1 && corner.triangles == 0 );
+
+	// the top right, where the triangle is
+	Census topRight;
+	grid.accept_in_region( Bounds( 75, 75, 100, 100 ), &topRight );
+	cout << "top right: " << topRight.total() << " shapes" << endl;
+	assert( topRight.triangles == 1 && topRight.total() == 1 );
+
+	// way out past the edge still finds the stray circle
+	Census outside;
+	grid.accept_in_region( Bounds( 140, 140, 160, 160 ), &outside );
+	cout << "outside: " << outside.total() << " shapes" << endl;
+	assert( outside.circles == 1 && outside.total() == 1 );
+
+	// so does a region that goes off forever, and one that's all NaN finds nothing
+	Census forever;
+	grid.accept_in_region( Bounds( 140, 140, HUGE_VALF, 1e30f ), &forever );
+	assert( forever.circles == 1 && forever.total() == 1 );
+
+	Census nowhere;
+	grid.accept_in_region( Bounds( NAN, NAN, NAN, NAN ), &nowhere );
+	assert( nowhere.total() == 0 );
+
+	// the circle wanders over to the triangle
+	Circle* wanderer = static_cast<Circle*>( shapes[1] );
+	wanderer->x = 85;
+	wanderer->y = 85;
+	grid.update( wanderer, boundsOf( wanderer ) );
+
+	Census afterMove;
+	grid.accept_in_region( Bounds( 75, 75, 100, 100 ), &afterMove );
+	cout << "top right after the move: " << afterMove.total() << " shapes" << endl;
+	assert( afterMove.circles == 1 && afterMove.triangles == 1 );
+
+	// and the long rectangle goes away
+	grid.remove( shapes[3] );
+	Census afterRemove;
+	grid.accept_in_region( Bounds( 0, 0, 100, 100 ), &afterRemove );
+	cout << "everything in the world: " << afterRemove.total() << " shapes" << endl;
+	assert( afterRemove.total() == 3 );
+
+	for ( size_t i = 0; i < shapes.size(); ++i ) {
+		delete shapes[i];
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+//
+//		The Static Visitor
+//
+//	Every visit through the classic Visitor is two virtual calls:
+//	accept on the shape, then visit on the visitor. The compiler
+//	can't see through either, so a loop over a thousand shapes is
+//	two thousand calls into who-knows-where, and nothing gets inlined.
+//
+//	If the visitor's type is a template parameter instead,
+//	the compiler knows exactly which visit gets called.
+//	The shape still has to say what it is, but it can do that
+//	with a little tag and a switch instead of a virtual call.
+//	That's the Curiously Recurring Template Pattern (CRTP):
+//	a visitor derives from StaticVisitor<itself>, so the base
+//	can call back into it without anything being virtual.
+//
+//	The old virtual accept is still there, so code that only has
+//	a Visitor* keeps working, and a static visitor can go down
+//	that road too through a small adapter.
+//
+//	The base class lives in static-visitor.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "static-visitor.h"
+#include "output-sink.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+class Visitor;
+class Rectangle;
+class Circle;
+
+class Shape {
+public:
+	enum Kind { RECTANGLE, CIRCLE };
+
+	virtual ~Shape() {}
+	float x, y;
+	const Kind kind;
+	Shape( Kind kind, float x, float y ) : x(x), y(y), kind(kind) {}
+
+	// the runtime path, same as always
+	virtual void accept( Visitor* visitor ) = 0;
+
+	// the compile-time path; defined once the shapes are
+	template<typename V>
+	void accept( StaticVisitor<V>& visitor );
+};
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(RECTANGLE,x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+	using Shape::accept;
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(CIRCLE,x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+	using Shape::accept;
+};
+
+// A switch on the tag. The compiler turns it into a compare or a jump,
+// and each case is a direct call it can inline.
+template<typename V>
+inline void Shape::accept( StaticVisitor<V>& visitor ) {
+
+	switch ( kind ) {
+		case RECTANGLE: visitor.self().visit( static_cast<Rectangle&>( *this ) ); break;
+		case CIRCLE: visitor.self().visit( static_cast<Circle&>( *this ) ); break;
+	}
+}
+
+// Lets a static visitor ride the runtime path.
+// One virtual call per shape, but only one, and only when you ask for it.
+template<typename Static>
+class Dynamic : public Visitor {
+public:
+	Dynamic( Static& visitor ) : visitor(visitor) {}
+	void visit( Rectangle* rectangle ) { visitor.visit( *rectangle ); }
+	void visit( Circle* circle ) { visitor.visit( *circle ); }
+private:
+	Static& visitor;
+};
+
+// The visitors. Nothing virtual anywhere.
+class AreaCalculator : public StaticVisitor<AreaCalculator> {
+public:
+	AreaCalculator( OutputSink& out ) : out(out) {}
+
+	void visit( Rectangle& rectangle ) {
+
+		float area;
+		area = rectangle.w * rectangle.h;
+		out << "rectangle area is: " << area << '\n';
+	}
+
+	void visit( Circle& circle ) {
+
+		float area;
+		area = PI * circle.r * circle.r;
+		out << "circle area is: " << area << '\n';
+	}
+
+private:
+	OutputSink& out;
+};
+
+class RectangleCounter : public StaticVisitor<RectangleCounter> {
+public:
+	float count;
+	RectangleCounter() : count(0) {}
+
+	void reset() { count = 0; }
+
+	void visit( Rectangle& rectangle ) { ++count; }
+	void visit( Circle& circle ) {}
+};
+
+typedef vector<Shape*> ShapeList;
+
+int main() {
+
+	Rectangle r1(0,0,10,20), r2(10,10, 5,3);
+	Circle c(5,5, 15);
+
+	ShapeList list;
+	list.push_back( &r1 );
+	list.push_back( &r2 );
+	list.push_back( &c );
+
+	OutputSink out( cout );
+
+	// areas, inlined
+	AreaCalculator ac( out );
+	ac.visitAll( list );
+	out.flush();
+
+	// counting, inlined
+	RectangleCounter rc;
+	cout << "there are " << rc.visitAll( list ).count << " rectangles" << endl;
+
+	// same counter, the old-fashioned way
+	rc.reset();
+	Dynamic<RectangleCounter> dynamic( rc );
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		list[i]->accept( &dynamic );
+	}
+	cout << "there are " << rc.count << " rectangles, virtually" << endl;
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef STATIC_VISITOR_H
+#define STATIC_VISITOR_H
+
+// The base for visitors that get dispatched at compile time.
+//
+// Derived just writes plain, non-virtual visit( T& ) overloads.
+// A visitable hierarchy that wants the static path gives its base a
+//	template<typename V> void accept( StaticVisitor<V>& visitor )
+// that works out the concrete type without a virtual call (a type tag
+// and a switch, say) and calls visitor.self().visit( concrete ).
+// Since V is a template parameter, the compiler can see right through
+// to Derived::visit and inline it into the traversal loop.
+//
+// The virtual accept( Visitor* ) can stay right next to it; the two
+// paths don't know about each other.
+template<typename Derived>
+class StaticVisitor {
+public:
+	Derived& self() { return static_cast<Derived&>( *this ); }
+	const Derived& self() const { return static_cast<const Derived&>( *this ); }
+
+	// anything with begin/end over pointers to the visitable base
+	template<typename List>
+	Derived& visitAll( const List& list ) {
+
+		for ( auto* element : list ) {
+			element->accept( *this );
+		}
+		return self();
+	}
+
+protected:
+	StaticVisitor() {}
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <vector>
+#include <typeinfo>
+#include <typeindex>
+#include <cstddef>
+#include <cstdint>
+
+// A pointer and a length, which is all std::span really is.
+// (std::span is C++20, these demos are C++17.)
+template<typename T>
+class Span {
+public:
+	Span() : m_data( nullptr ), m_size( 0 ) {}
+	Span( T* data, std::size_t size ) : m_data( data ), m_size( size ) {}
+
+	T* begin() const { return m_data; }
+	T* end() const { return m_data + m_size; }
+	T& operator[]( std::size_t i ) const { return m_data[i]; }
+	std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+private:
+	T* m_data;
+	std::size_t m_size;
+};
+
+// A run of Base pointers that are all known to point at a T.
+// Handing them out as T* is a static_cast per element,
+// which is free for the usual single inheritance.
+template<typename T, typename Base>
+class Batch {
+public:
+	class iterator {
+	public:
+		iterator( Base* const* at ) : m_at( at ) {}
+		T* operator*() const { return static_cast<T*>( *m_at ); }
+		iterator& operator++() { ++m_at; return *this; }
+		bool operator!=( const iterator& other ) const { return m_at != other.m_at; }
+	private:
+		Base* const* m_at;
+	};
+
+	explicit Batch( Span<Base* const> items ) : m_items( items ) {}
+
+	T* operator[]( std::size_t i ) const { return static_cast<T*>( m_items[i] ); }
+	std::size_t size() const { return m_items.size(); }
+	iterator begin() const { return iterator( m_items.begin() ); }
+	iterator end() const { return iterator( m_items.end() ); }
+
+private:
+	Span<Base* const> m_items;
+};
+
+// A hint to start pulling the memory at address into cache.
+// Does nothing where there's no way to ask.
+inline void prefetch( const void* address ) {
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+	__builtin_prefetch( address );
+#else
+	( void ) address;
+#endif
+}
+
+// Calls fn( list[i] ) in order, asking for the object `distance`
+// elements ahead to be fetched while the current one is worked on.
+// With scattered heap objects, that hides most of the waiting
+// on memory. Too short and the fetch arrives late; too long and it's
+// pushed back out of cache before it's used. 8 to 16 is usually right,
+// but measure it.
+template<typename T, typename Fn>
+void for_each_prefetched( const std::vector<T*>& list, Fn fn, std::size_t distance = 8 ) {
+
+	const std::size_t size = list.size();
+	for ( std::size_t i = 0; i < size; ++i ) {
+
+		if ( i + distance < size ) {
+			prefetch( list[i + distance] );
+		}
+		fn( list[i] );
+	}
+}
+
+// The usual accept loop, with the prefetching.
+template<typename T, typename VisitorType>
+void accept_prefetched( const std::vector<T*>& list, VisitorType* visitor, std::size_t distance = 8 ) {
+
+	for_each_prefetched( list, [visitor]( T* element ) { element->accept( visitor ); }, distance );
+}
+
+// Groups a list of shapes by concrete type so each type's visit
+// can run as one tight, well-predicted loop.
+//
+// The grouping is stable: types come out in the order they were first
+// seen, and elements keep their order within a type. update() only
+// regroups when the list has actually changed, so a scene that sits
+// still pays for one sequential compare per frame.
+//
+// "Changed" goes by the addresses alone, so the check never touches the
+// shapes themselves. That can't see a shape that's freed and replaced by
+// one of a different type at the same address, which pools do all the
+// time. So either pass update() a generation that changes whenever
+// storage is reused (ShapePool::generation() does), or call rebuild()
+// after reusing it.
+//
+// Base needs a virtual
+//	void acceptBatch( SomeVisitor* visitor, Span<Base* const> batch )
+// that each concrete type implements by handing the visitor a Batch of itself.
+template<typename Base>
+class TypeBatches {
+public:
+	TypeBatches() : m_generation( 0 ) {}
+
+	// returns true if it had to regroup
+	bool update( const std::vector<Base*>& list, std::uint64_t generation = 0 ) {
+
+		if ( generation == m_generation && list == m_source ) {
+
+			return false;
+		}
+
+		rebuild( list, generation );
+		return true;
+	}
+
+	// regroups no matter what
+	void rebuild( const std::vector<Base*>& list, std::uint64_t generation = 0 ) {
+
+		m_source = list;
+		m_generation = generation;
+		regroup();
+	}
+
+	std::size_t groupCount() const {
+
+		return m_types.size();
+	}
+
+	Span<Base* const> group( std::size_t i ) const {
+
+		return Span<Base* const>( m_sorted.data() + m_starts[i], m_starts[i + 1] - m_starts[i] );
+	}
+
+	const std::vector<Base*>& sorted() const {
+
+		return m_sorted;
+	}
+
+	// One virtual call per type instead of two per element.
+	template<typename VisitorType>
+	void accept( VisitorType* visitor ) const {
+
+		for ( std::size_t i = 0; i < groupCount(); ++i ) {
+
+			Span<Base* const> batch = group( i );
+			batch[0]->acceptBatch( visitor, batch );
+		}
+	}
+
+private:
+	void regroup() {
+
+		m_types.clear();
+		std::vector<unsigned> groups( m_source.size() );
+		std::vector<std::size_t> counts;
+
+		// there are only ever a handful of types, so a linear search
+		// with a remember-the-last-one shortcut beats a hash map
+		unsigned last = 0;
+		for ( std::size_t i = 0; i < m_source.size(); ++i ) {
+
+			const std::type_index type( typeid( *m_source[i] ) );
+			if ( m_types.empty() || m_types[last] != type ) {
+
+				last = 0;
+				while ( last < m_types.size() && m_types[last] != type ) {
+					++last;
+				}
+				if ( last == m_types.size() ) {
+					m_types.push_back( type );
+					counts.push_back( 0 );
+				}
+			}
+
+			groups[i] = last;
+			++counts[last];
+		}
+
+		m_starts.assign( m_types.size() + 1, 0 );
+		for ( std::size_t g = 0; g < m_types.size(); ++g ) {
+
+			m_starts[g + 1] = m_starts[g] + counts[g];
+		}
+
+		std::vector<std::size_t> at( m_starts.begin(), m_starts.end() - 1 );
+		m_sorted.resize( m_source.size() );
+		for ( std::size_t i = 0; i < m_source.size(); ++i ) {
+
+			m_sorted[at[groups[i]]++] = m_source[i];
+		}
+	}
+
+	std::vector<Base*> m_source;
+	std::uint64_t m_generation;
+	std::vector<Base*> m_sorted;
+	std::vector<std::type_index> m_types;
+	std::vector<std::size_t> m_starts;
+};
+
+#endif
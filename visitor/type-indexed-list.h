@@ -0,0 +1,189 @@
+#ifndef TYPE_INDEXED_LIST_H
+#define TYPE_INDEXED_LIST_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "../rtti/rtti.h"
+#include "traversal.h"
+
+// A list of entities kept sorted into one bucket per concrete type,
+// indexed by RTTI index, and kept that way as things come and go.
+//
+// "Give me everything that's a Rectangle" is the buckets of Rectangle
+// and every subtype of it that has anything in it. Each type keeps a list
+// of those, so a query only ever touches buckets with matches in them.
+// Counting is a running total per type, subtypes included, so it's O(1).
+//
+// Inserting and removing walk the ancestor bitset of the entity's type,
+// which is a handful of bits. Removing swaps the last entity in the
+// bucket into the hole, so order within a bucket isn't kept.
+//
+// Entities are handed out as T* with a static_cast from Base, so Base
+// can't be a virtual base of T.
+template<typename Base>
+class TypeIndexedList {
+public:
+	// false if it's already in here, and nothing changes
+	bool insert( Base* entity ) {
+
+		const RTTI& type = entity->getTypeInfo();
+		const unsigned index = type.getIndex();
+		grow( index );
+
+		std::vector<Base*>& bucket = m_buckets[index];
+		if ( !m_locations.emplace( entity, bucket.size() ).second ) {
+			return false;
+		}
+		bucket.push_back( entity );
+
+		const bool firstOne = bucket.size() == 1;
+		forEachAncestor( type, [this, index, firstOne]( unsigned ancestor ) {
+
+			++m_counts[ancestor];
+			if ( firstOne ) {
+				m_occupied[ancestor].push_back( index );
+			}
+		} );
+
+		return true;
+	}
+
+	// false if it wasn't in here
+	bool remove( Base* entity ) {
+
+		typename std::unordered_map<Base*, std::size_t>::iterator found = m_locations.find( entity );
+		if ( found == m_locations.end() ) {
+			return false;
+		}
+
+		const RTTI& type = entity->getTypeInfo();
+		const unsigned index = type.getIndex();
+		std::vector<Base*>& bucket = m_buckets[index];
+
+		const std::size_t at = found->second;
+		m_locations.erase( found );
+		if ( at + 1 != bucket.size() ) {
+
+			bucket[at] = bucket.back();
+			m_locations[bucket[at]] = at;
+		}
+		bucket.pop_back();
+
+		const bool lastOne = bucket.empty();
+		forEachAncestor( type, [this, index, lastOne]( unsigned ancestor ) {
+
+			--m_counts[ancestor];
+			if ( lastOne ) {
+
+				std::vector<unsigned>& occupied = m_occupied[ancestor];
+				for ( std::size_t i = 0; i < occupied.size(); ++i ) {
+
+					if ( occupied[i] == index ) {
+						occupied[i] = occupied.back();
+						occupied.pop_back();
+						break;
+					}
+				}
+			}
+		} );
+
+		return true;
+	}
+
+	bool contains( Base* entity ) const {
+
+		return m_locations.count( entity ) != 0;
+	}
+
+	std::size_t size() const {
+
+		return m_locations.size();
+	}
+
+	// how many are, or derive from, the type
+	std::size_t count( const RTTI& type ) const {
+
+		return type.getIndex() < m_counts.size() ? m_counts[type.getIndex()] : 0;
+	}
+
+	template<typename T>
+	std::size_t count() const {
+
+		return count( T::typeInfo );
+	}
+
+	// the entities of exactly this type, not its subtypes
+	Span<Base* const> bucket( const RTTI& type ) const {
+
+		const unsigned index = type.getIndex();
+		return index < m_buckets.size() ? Span<Base* const>( m_buckets[index].data(), m_buckets[index].size() ) : Span<Base* const>();
+	}
+
+	// every non-empty bucket whose type is, or derives from, the type
+	std::vector<Span<Base* const>> query( const RTTI& type ) const {
+
+		std::vector<Span<Base* const>> spans;
+		if ( type.getIndex() < m_occupied.size() ) {
+
+			const std::vector<unsigned>& occupied = m_occupied[type.getIndex()];
+			for ( std::size_t i = 0; i < occupied.size(); ++i ) {
+				spans.push_back( Span<Base* const>( m_buckets[occupied[i]].data(), m_buckets[occupied[i]].size() ) );
+			}
+		}
+		return spans;
+	}
+
+	// calls fn( T* ) for everything that is a T, one bucket at a time
+	template<typename T, typename Fn>
+	void forEach( Fn fn ) const {
+
+		if ( T::typeInfo.getIndex() >= m_occupied.size() ) {
+			return;
+		}
+
+		const std::vector<unsigned>& occupied = m_occupied[T::typeInfo.getIndex()];
+		for ( std::size_t i = 0; i < occupied.size(); ++i ) {
+
+			const std::vector<Base*>& items = m_buckets[occupied[i]];
+			for ( T* entity : Batch<T, Base>( Span<Base* const>( items.data(), items.size() ) ) ) {
+				fn( entity );
+			}
+		}
+	}
+
+private:
+	void grow( unsigned index ) {
+
+		const std::size_t size = std::max<std::size_t>( index + 1, RTTIRegistry::typeCount() );
+		if ( size > m_buckets.size() ) {
+
+			m_buckets.resize( size );
+			m_counts.resize( size, 0 );
+			m_occupied.resize( size );
+		}
+	}
+
+	// a type's own bit is in its ancestor set too
+	template<typename Fn>
+	static void forEachAncestor( const RTTI& type, Fn fn ) {
+
+		const std::vector<std::uint64_t>& ancestors = type.getAncestors();
+		for ( std::size_t word = 0; word < ancestors.size(); ++word ) {
+
+			for ( std::uint64_t bits = ancestors[word]; bits; bits &= bits - 1 ) {
+				fn( static_cast<unsigned>( word * 64 + __builtin_ctzll( bits ) ) );
+			}
+		}
+	}
+
+	std::vector<std::vector<Base*>> m_buckets;
+	std::vector<std::size_t> m_counts;
+	std::vector<std::vector<unsigned>> m_occupied;
+	std::unordered_map<Base*, std::size_t> m_locations;
+};
+
+#endif
@@ -0,0 +1,129 @@
+//
+//			The Type Tag
+//
+//	Asking a shape what it is usually costs a virtual call: accept,
+//	or getTypeInfo(). That's fine for a visitor that's going to do
+//	real work once it knows, but for "how many rectangles are there?"
+//	or "sort these into piles by type", the virtual call is most of
+//	the cost.
+//
+//	So every shape carries a little number, its type's RTTI index,
+//	in the object itself. Reading it is one load. It's a perfectly
+//	good array index, so piles by type are an array of piles, and
+//	dispatch is an array of functions.
+//
+//	And with a set of "every type that derives from Rectangle" worked
+//	out ahead of time, "is this a Rectangle or a Square or some other
+//	kind of rectangle" is the tag, one word out of the set, and a bit test.
+//
+//	The tag and the sets live in ../rtti/type-tag.h.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cassert>
+
+#include "../rtti/type-tag.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+// RTTITaggedAs tags the object with the type it names.
+// The most derived one goes last, so it wins.
+class Shape : public RTTITaggedAs<Shape> {
+	RTTI_DECLARE();
+public:
+	virtual ~Shape() {}
+	float x, y;
+	Shape( float x, float y ) : x(x), y(y) {}
+};
+
+class Rectangle : public RTTITaggedAs<Rectangle, Shape> {
+	RTTI_DECLARE();
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : RTTITaggedAs(x,y), w(w), h(h) {}
+};
+
+class Square : public RTTITaggedAs<Square, Rectangle> {
+	RTTI_DECLARE();
+public:
+	Square( float x, float y, float side ) : RTTITaggedAs(x,y, side,side) {}
+};
+
+class Circle : public RTTITaggedAs<Circle, Shape> {
+	RTTI_DECLARE();
+public:
+	float r;
+	Circle( float x, float y, float r ) : RTTITaggedAs(x,y), r(r) {}
+};
+
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Square, Rectangle);
+RTTI_DEFINE(Circle, Shape);
+
+typedef vector<Shape*> ShapeList;
+
+// The area of each type, in a table indexed by tag.
+typedef float (*AreaFunction)( Shape* shape );
+
+float rectangleArea( Shape* shape ) { Rectangle* r = static_cast<Rectangle*>( shape ); return r->w * r->h; }
+float circleArea( Shape* shape ) { Circle* c = static_cast<Circle*>( shape ); return PI * c->r * c->r; }
+
+int main() {
+
+	ShapeList list;
+	list.push_back( new Rectangle(0,0,10,20) );
+	list.push_back( new Circle(5,5, 15) );
+	list.push_back( new Square(1,1, 4) );
+	list.push_back( new Rectangle(10,10, 5,3) );
+	list.push_back( new Circle(2,2, 1) );
+
+	// the tag is the type index, no virtual call needed to read it
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		assert( list[i]->getTypeTag() == list[i]->getTypeInfo().getIndex() );
+	}
+
+	// rectangles, squares included
+	const RTTITagSet rectangles( Rectangle::typeInfo );
+	int rectangleCount = 0;
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		rectangleCount += rectangles.contains( list[i]->getTypeTag() );
+	}
+	cout << "there are " << rectangleCount << " rectangles (one of them's a square)" << endl;
+	assert( rectangleCount == 3 );
+
+	// piles by exact type
+	vector<ShapeList> piles( RTTIRegistry::typeCount() );
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		piles[list[i]->getTypeTag()].push_back( list[i] );
+	}
+	for ( size_t tag = 0; tag < piles.size(); ++tag ) {
+
+		if ( !piles[tag].empty() ) {
+			cout << "pile of " << RTTIRegistry::find( unsigned( tag ) )->getClassName() << "s: " << piles[tag].size() << endl;
+		}
+	}
+
+	// dispatch through a table instead of a vtable
+	vector<AreaFunction> area( RTTIRegistry::typeCount(), nullptr );
+	area[Rectangle::typeInfo.getIndex()] = &rectangleArea;
+	area[Square::typeInfo.getIndex()] = &rectangleArea;
+	area[Circle::typeInfo.getIndex()] = &circleArea;
+
+	float total = 0;
+	for ( size_t i = 0; i < list.size(); ++i ) {
+
+		if ( AreaFunction f = area[list[i]->getTypeTag()] ) {
+			total += f( list[i] );
+		}
+	}
+	cout << "total area is: " << total << endl;
+
+	for ( size_t i = 0; i < list.size(); ++i )
+		delete list[i];
+
+	return 0;
+}
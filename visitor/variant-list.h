@@ -0,0 +1,71 @@
+#ifndef VARIANT_LIST_H
+#define VARIANT_LIST_H
+
+#include <vector>
+#include <variant>
+#include <utility>
+#include <cstddef>
+
+// A ShapeList for a closed hierarchy: the shapes themselves,
+// stored by value in one contiguous array of std::variant.
+//
+// visit hands each element to a function object with one operator()
+// per type. std::visit picks the overload through a jump table on the
+// variant's index, and because the function object's type is known,
+// the bodies get inlined into it. No pointers, no virtual calls.
+//
+// The elements are still real Rectangles and Circles, accept and all,
+// so old code can keep calling accept on them.
+template<typename... Types>
+class VariantList {
+public:
+	typedef std::variant<Types...> value_type;
+
+	template<typename T, typename... Args>
+	T& emplace( Args&&... args ) {
+
+		m_items.emplace_back( std::in_place_type<T>, std::forward<Args>( args )... );
+		return std::get<T>( m_items.back() );
+	}
+
+	template<typename Fn>
+	void visit( Fn&& fn ) {
+
+		for ( std::size_t i = 0; i < m_items.size(); ++i ) {
+			std::visit( fn, m_items[i] );
+		}
+	}
+
+	value_type& operator[]( std::size_t i ) { return m_items[i]; }
+	std::size_t size() const { return m_items.size(); }
+	void reserve( std::size_t n ) { m_items.reserve( n ); }
+	void clear() { m_items.clear(); }
+
+	typename std::vector<value_type>::iterator begin() { return m_items.begin(); }
+	typename std::vector<value_type>::iterator end() { return m_items.end(); }
+
+private:
+	std::vector<value_type> m_items;
+};
+
+// Lets an old-school Visitor (one visit( T* ) per type) be used
+// with VariantList::visit, so visitors can be moved over one at a time.
+template<typename VisitorType>
+class VisitorAdapter {
+public:
+	explicit VisitorAdapter( VisitorType* visitor ) : m_visitor( visitor ) {}
+
+	template<typename T>
+	void operator()( T& shape ) const { m_visitor->visit( &shape ); }
+
+private:
+	VisitorType* m_visitor;
+};
+
+template<typename VisitorType>
+VisitorAdapter<VisitorType> adapt( VisitorType* visitor ) {
+
+	return VisitorAdapter<VisitorType>( visitor );
+}
+
+#endif
@@ -0,0 +1,126 @@
+//
+//		The Variant Visitor
+//
+//	Remember how the Visitor wants a stable class hierarchy?
+//	Well, if it's stable enough, it's closed: we know it's Rectangles
+//	and Circles and nothing else, forever. And if we know that,
+//	we don't need pointers or virtual calls at all.
+//
+//	A std::variant<Rectangle, Circle> is a box big enough for either
+//	one, plus a little number saying which one is in there. Put those
+//	in a vector and the shapes sit side by side in memory.
+//	std::visit reads the little number, jumps straight to the right
+//	overload, and since the compiler can see the whole visitor,
+//	it inlines the lot.
+//
+//	The catch is the usual one, only more so: add a Triangle and
+//	every variant visitor has to learn about it before it compiles.
+//
+//	The old Visitors still work through an adapter, so you can move
+//	things over one at a time. See variant-list.h.
+//
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "variant-list.h"
+
+using namespace std;
+
+#define PI 3.1415
+
+// The classic hierarchy from visitor.cpp, more or less.
+class Visitor;
+
+class Shape {
+	public:
+		virtual ~Shape() {}
+		float x, y;
+		Shape( float x, float y ) : x(x), y(y) {}
+		virtual void accept( Visitor* visitor ) = 0;
+};
+
+class Rectangle;
+class Circle;
+
+class Visitor {
+public:
+	virtual void visit( Rectangle* rectangle ) = 0;
+	virtual void visit( Circle* circle ) = 0;
+};
+
+class Rectangle : public Shape {
+public:
+	float w, h;
+	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+class Circle : public Shape {
+public:
+	float r;
+	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
+	void accept( Visitor* visitor ) { visitor->visit( this ); }
+};
+
+// An old Visitor we haven't gotten around to moving over.
+class Namer : public Visitor {
+public:
+	void visit( Rectangle* rectangle ) { cout << "name: " << "rectangle" << endl; }
+	void visit( Circle* circle ) { cout << "name: " << "circle" << endl; }
+};
+
+// The variant versions are just function objects
+// with an overload per shape. No base class needed.
+class AreaCalculator {
+public:
+	void operator()( Rectangle& rectangle ) const {
+
+		float area;
+		area = rectangle.w * rectangle.h;
+		cout << "rectangle area is: " << area << endl;
+	}
+
+	void operator()( Circle& circle ) const {
+
+		float area;
+		area = PI * circle.r * circle.r;
+		cout << "circle area is: " << area << endl;
+	}
+};
+
+class RectangleCounter {
+public:
+	float count;
+	RectangleCounter() : count(0) {}
+
+	void operator()( Rectangle& rectangle ) { ++count; }
+	void operator()( Circle& circle ) {}
+};
+
+typedef VariantList<Rectangle, Circle> ShapeValues;
+
+int main() {
+
+	// The shapes go straight into the list. No new, no delete.
+	ShapeValues list;
+	list.emplace<Rectangle>( 0,0,10,20 );
+	list.emplace<Rectangle>( 10,10, 5,3 );
+	list.emplace<Circle>( 5,5, 15 );
+
+	// areas
+	AreaCalculator ac;
+	list.visit( ac );
+
+	// name, through the adapter
+	Namer n;
+	list.visit( adapt( &n ) );
+
+	// counting
+	RectangleCounter rc;
+	list.visit( rc );
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	return 0;
+}
@@ -26,6 +26,15 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cassert>
+
+#include "../rtti/instrumentation.h"
+#include "../rtti/rtti.h"
+#include "traversal.h"
+#include "output-sink.h"
+#include "shape-pool.h"
+#include "multi-dispatch.h"
+
 using namespace std;
 
 #define PI 3.1415
@@ -37,7 +46,9 @@ class Visitor;
 // The base Shape class.
 // This is the "data class."
 // It's the classes deriving from Shape that we're really interested in.
+// (It carries the home-brewed RTTI too, but only for the pairs demo at the end.)
 class Shape {
+	RTTI_DECLARE();
 	public:
 		// Dummy structure to demonstrate the idea of the class.
 		virtual ~Shape() {}
@@ -49,6 +60,12 @@ class Shape {
 		// This method is used by derived Shapes to tell Visitors
 		// which class they're visiting.
 		virtual void accept( Visitor* visitor ) = 0;
+
+		// The batched accept.
+		// Every Shape in the batch is the same type as this one,
+		// so the derived class can tell the Visitor what it's visiting
+		// once for the whole lot. See TypeBatches in traversal.h.
+		virtual void acceptBatch( Visitor* visitor, Span<Shape* const> batch ) = 0;
 };
 
 // Forward declarations for the classes the Visitor visits.
@@ -71,10 +88,24 @@ public:
 	// Remember, type inferenence magic - it's the bee's knees!
 	virtual void visit( Rectangle* rectangle ) = 0;
 	virtual void visit( Circle* circle ) = 0;
+
+	// And batched visits, one per class, for when the Shapes come
+	// grouped by type. By default they just visit one at a time,
+	// but since every call here goes to the same place, the loop
+	// is a lot friendlier to the branch predictor.
+	// Override them when the whole batch can be done at once.
+	virtual void visit( Batch<Rectangle, Shape> rectangles ) {
+		for ( Rectangle* rectangle : rectangles ) visit( rectangle );
+	}
+
+	virtual void visit( Batch<Circle, Shape> circles ) {
+		for ( Circle* circle : circles ) visit( circle );
+	}
 };
 
 // It's a rectangle!
 class Rectangle : public Shape {
+	RTTI_DECLARE();
 public:
 	float w, h;
 	Rectangle( float x, float y, float w, float h ) : Shape(x,y), w(w), h(h) {}
@@ -83,17 +114,26 @@ public:
 	// tells the Visitor to visit, well, a Rectangle.
 	// Note that this could be rewritten as visitor->visitRectangle( this )
 	// but idiomatically, the method is just called visit for every type.
-	void accept( Visitor* visitor ) { visitor->visit( this ); }
+	void accept( Visitor* visitor ) { INSTRUMENT_SCOPE( ACCEPT ); visitor->visit( this ); }
+
+	void acceptBatch( Visitor* visitor, Span<Shape* const> batch ) {
+		visitor->visit( Batch<Rectangle, Shape>( batch ) );
+	}
 };
 
 // And a circle! Whoa!
 class Circle : public Shape {
+	RTTI_DECLARE();
 public:
 	float r;
 	Circle( float x, float y, float r ) : Shape(x,y), r(r) {}
 
 	// Pretty much the same song and dance.
-	void accept( Visitor* visitor ) { visitor->visit( this ); }
+	void accept( Visitor* visitor ) { INSTRUMENT_SCOPE( ACCEPT ); visitor->visit( this ); }
+
+	void acceptBatch( Visitor* visitor, Span<Shape* const> batch ) {
+		visitor->visit( Batch<Circle, Shape>( batch ) );
+	}
 };
 
 // For reference, here is a naive implementation of a Visitor.
@@ -124,34 +164,46 @@ public:
 
 // Here's an implementation of the Visitor.
 // It calcultates the area of each shape it visits.
+// It writes to an OutputSink rather than straight to cout,
+// so printing a line doesn't mean flushing a line.
 class AreaCalculator : public Visitor {
 public:
+	AreaCalculator( OutputSink& out ) : out(out) {}
+
 	void visit( Rectangle* rectangle ) {
 
 		float area;
 		area = rectangle->w * rectangle->h;
-		cout << "rectangle area is: " << area << endl;
+		out << "rectangle area is: " << area << '\n';
 	}
 
 	void visit( Circle* circle ) {
 
 		float area;
 		area = PI * circle->r * circle->r;
-		cout << "circle area is: " << area << endl;
+		out << "circle area is: " << area << '\n';
 	}
+
+private:
+	OutputSink& out;
 };
 
 // Here's another implementation.
 // It prints out the name of each shape it visits.
 class Namer : public Visitor {
 public:
+	Namer( OutputSink& out ) : out(out) {}
+
 	void visit( Rectangle* rectangle ) {
-		cout << "name: " << "rectangle" << endl;
+		out << "name: " << "rectangle" << '\n';
 	}
 
 	void visit( Circle* circle ) {
-		cout << "name: " << "circle" << endl;
+		out << "name: " << "circle" << '\n';
 	}
+
+private:
+	OutputSink& out;
 };
 
 // And one last implementation.
@@ -165,13 +217,34 @@ public:
 	float count;
 	RectangleCounter() : count(0) {}
 
+	// so the same one can count again next frame
+	void reset() { count = 0; }
+
 	void visit(Circle* circle) {}
 	void visit(Rectangle* rectangle) { ++count; }
+
+	// When the Rectangles come all at once, counting them is easy.
+	using Visitor::visit;
+	void visit(Batch<Rectangle, Shape> rectangles) { count += rectangles.size(); }
 };
 
 // This is just a bit of junk to give us a ShapeList class.
 typedef vector<Shape*> ShapeList;
 
+RTTI_DEFINE(Shape);
+RTTI_DEFINE(Rectangle, Shape);
+RTTI_DEFINE(Circle, Shape);
+
+// A Visitor picks what to do from the type of one Shape.
+// When it takes two, see the pairs demo in main.
+void rectangleMeetsRectangle( Rectangle& a, Rectangle& b ) {
+	cout << "a " << a.w << "x" << a.h << " rectangle meets a " << b.w << "x" << b.h << " rectangle" << endl;
+}
+
+void rectangleMeetsCircle( Rectangle& a, Circle& b ) {
+	cout << "a " << a.w << "x" << a.h << " rectangle meets a circle of radius " << b.r << endl;
+}
+
 int main() {
 
 	// First, a collection of Shapes is created.
@@ -179,42 +252,98 @@ int main() {
 	// looks like a Shape. There's no way of looking at them and
 	// knowing that they're actually Rectangles and Circles without
 	// doing some kind of type inference.
+	// The Shapes themselves come out of a pool per type
+	// so they sit next to each other in memory instead of
+	// being scattered all over the heap by new.
+	ShapePool<Rectangle, Circle> shapes;
 	ShapeList list;
-	list.push_back( new Rectangle(0,0,10,20) );
-	list.push_back( new Rectangle(10,10, 5,3) );
-	list.push_back( new Circle( 5,5, 15) );
+	list.push_back( shapes.create<Rectangle>(0,0,10,20) );
+	list.push_back( shapes.create<Rectangle>(10,10, 5,3) );
+	list.push_back( shapes.create<Circle>( 5,5, 15) );
+
+	// The visitors live on the stack. Nothing to new, nothing to delete,
+	// and the same ones get used again further down (or next frame).
+	// Their output piles up in the sink and goes out once per traversal.
+	OutputSink out( cout );
+	AreaCalculator ac( out );
+	Namer n( out );
+	RectangleCounter rc;
 
 	// AreaCalculator demo.
-	// An AreaCalculator Visitor is created.
-	// Each of the shapes accepts it and then ask it to Visit them.
-	AreaCalculator *ac = new AreaCalculator();
+	// Each of the shapes accepts the AreaCalculator and then asks it to Visit them.
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( ac );
+		list[i]->accept( &ac );
 	}
-	delete ac;
+	out.flush();
 
 	// Namer demo.
-	Namer *n = new Namer();
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( n );
+		list[i]->accept( &n );
 	}
-	delete n;
+	out.flush();
 
 	// RectangleCounter demo.
-	RectangleCounter *rc = new RectangleCounter();
 	for ( int i = 0; i < list.size(); ++i ) {
-		list[i]->accept( rc );
+		list[i]->accept( &rc );
 	}
 
 	// Note that here, after visiting the Shapes,
 	// the state of the RectangleCounter can be queried to
 	// determine what it found out while visiting.
-	cout << "there are " << rc->count << " rectangles" << endl;
-	delete rc;
+	cout << "there are " << rc.count << " rectangles" << endl;
+
+	// Batched demo.
+	// The Shapes are grouped by type once, and the grouping is kept
+	// until the list or the pool changes. Each group is visited in one go.
+	TypeBatches<Shape> batches;
+	batches.update( list, shapes.generation() );
+
+	batches.accept( &ac );
+	out.flush();
+
+	rc.reset();
+	batches.accept( &rc );
+	cout << "there are " << rc.count << " batched rectangles" << endl;
+
+	// Next frame, nothing's changed, so the grouping stands. Then the
+	// Circle goes and a new one takes its slot: same list, same
+	// addresses, and only the pool's generation says it's not the same.
+	assert( !batches.update( list, shapes.generation() ) );
+	Shape* oldCircle = list[2];
+	shapes.destroy( static_cast<Circle*>( list[2] ) );
+	list[2] = shapes.create<Circle>( 5,5, 15 );
+	assert( list[2] == oldCircle );
+	assert( batches.update( list, shapes.generation() ) );
+
+	// Compacted and prefetched demo.
+	// compact packs the Shapes up tight, a run per type, and
+	// (since we said so) sorts the list to match. Then the walk
+	// asks for each Shape a few elements before it gets there.
+	shapes.compact( list, true );
+	rc.reset();
+	accept_prefetched( list, &rc );
+	cout << "there are " << rc.count << " compacted rectangles" << endl;
+
+	// Pairs demo.
+	// What happens when two Shapes meet depends on both their types.
+	// With visitors, that'd be a visitor per Shape visiting the other.
+	// The MultiDispatcher from multi-dispatch.h looks both types up
+	// in one table instead (see collision-matrix.cpp for more).
+	// Circle-meets-Rectangle comes free with Rectangle-meets-Circle,
+	// and nobody said what two Circles do, so they don't.
+	MultiDispatcher<Shape> meet;
+	meet.add( &rectangleMeetsRectangle );
+	meet.add( &rectangleMeetsCircle );
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		for ( size_t j = i + 1; j < list.size(); ++j ) {
+			meet.dispatch( *list[i], *list[j] );
+		}
+	}
 
 	// And then, some cleaing up.
-	for ( int i = 0; i < list.size(); ++i )
-		delete list[i];
+	// All at once, since the pool owns them.
+	list.clear();
+	shapes.clear();
 
 	return 0;
 }